@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+// Counts the heap allocations made by each phase of a query.
+//
+// This binary replaces the global operator new and delete, so every
+// allocation made by libcps, and the standard library on its behalf, is
+// counted. Each benchmark reports `allocs` and `bytes` per iteration, which
+// are more stable than times, so they can be tracked as metrics.
+
+#include "corpus.hpp"
+
+#include "cps/loader.hpp"
+#include "cps/pc_compat/pc_loader.hpp"
+#include "cps/printer.hpp"
+#include "cps/search.hpp"
+#include "cps/version.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+
+    void * allocate(std::size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+} // namespace
+
+// The array and nothrow forms call these by default
+void * operator new(std::size_t size) {
+    if (void * p = allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+// GCC does not know that these are the replacements for the operator new above
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { std::free(p); }
+
+namespace cps::bench {
+    namespace {
+
+        constexpr const char * null_device =
+#ifdef _WIN32
+            "NUL"
+#else
+            "/dev/null"
+#endif
+            ;
+
+        /// @brief Counts the allocations made from construction until report() is called
+        class Allocations {
+          public:
+            Allocations()
+                : count{allocations.load(std::memory_order_relaxed)},
+                  bytes{allocated_bytes.load(std::memory_order_relaxed)} {}
+
+            /// @brief Report the allocations as an average per iteration
+            void report(benchmark::State & state) const {
+                state.counters["allocs"] =
+                    benchmark::Counter(static_cast<double>(allocations.load(std::memory_order_relaxed) - count),
+                                       benchmark::Counter::kAvgIterations);
+                state.counters["bytes"] =
+                    benchmark::Counter(static_cast<double>(allocated_bytes.load(std::memory_order_relaxed) - bytes),
+                                       benchmark::Counter::kAvgIterations, benchmark::Counter::OneK::kIs1024);
+            }
+
+          private:
+            const uint64_t count;
+            const uint64_t bytes;
+        };
+
+        /// @brief The standard corpora, which numbers should be compared on
+        const CorpusOptions tree{.packages = 64, .diamond_density = 0};
+        const CorpusOptions diamonds{.packages = 64, .diamond_density = 0.5};
+        const CorpusOptions pc_mix{.packages = 64, .diamond_density = 0, .pc_fraction = 0.5};
+        const CorpusOptions components{.packages = 64, .diamond_density = 0, .components = 8};
+
+        const std::vector<std::string> requires_{"dep0", "dep1", "dep2", "dep3"};
+
+        /// @brief Expanding the search paths, done once per Session
+        void session(benchmark::State & state, const CorpusOptions & opts) {
+            const Corpus corpus{opts};
+            const Allocations allocs{};
+            for (auto _ : state) {
+                search::Session s{corpus.env()};
+                benchmark::DoNotOptimize(s);
+            }
+            allocs.report(state);
+        }
+        BENCHMARK_CAPTURE(session, tree, tree);
+
+        /// @brief Parsing a single CPS file
+        void parse_cps(benchmark::State & state, const CorpusOptions & opts) {
+            const std::string text = make_cps("bench", requires_, opts);
+            const Allocations allocs{};
+            for (auto _ : state) {
+                std::istringstream in{text};
+                benchmark::DoNotOptimize(loader::load(in, "/opt/bench/lib/cps/bench.cps"));
+            }
+            allocs.report(state);
+        }
+        BENCHMARK_CAPTURE(parse_cps, tree, tree);
+        BENCHMARK_CAPTURE(parse_cps, components, components);
+
+        /// @brief Parsing a single pc file
+        void parse_pc(benchmark::State & state, const CorpusOptions & opts) {
+            const std::string text = make_pc("bench", requires_, opts);
+            const Allocations allocs{};
+            for (auto _ : state) {
+                std::istringstream in{text};
+                benchmark::DoNotOptimize(pc_compat::load(in, "/opt/bench/lib/pkgconfig/bench.pc"));
+            }
+            allocs.report(state);
+        }
+        BENCHMARK_CAPTURE(parse_pc, tree, tree);
+
+        /// @brief A whole query with nothing cached, including finding and loading every file
+        void find_package_cold(benchmark::State & state, const CorpusOptions & opts) {
+            const Corpus corpus{opts};
+            const Allocations allocs{};
+            for (auto _ : state) {
+                search::Session s{corpus.env()};
+                benchmark::DoNotOptimize(search::find_package(s, "pkg0", {}, true, std::nullopt));
+            }
+            allocs.report(state);
+        }
+        BENCHMARK_CAPTURE(find_package_cold, tree, tree);
+        BENCHMARK_CAPTURE(find_package_cold, diamonds, diamonds);
+        BENCHMARK_CAPTURE(find_package_cold, pc_mix, pc_mix);
+        BENCHMARK_CAPTURE(find_package_cold, components, components);
+
+        /// @brief A query with every file already loaded, which is building the graph and the result
+        void resolve(benchmark::State & state, const CorpusOptions & opts) {
+            const Corpus corpus{opts};
+            search::Session s{corpus.env()};
+            // Load everything before counting
+            if (auto && r = search::find_package(s, "pkg0", {}, true, std::nullopt); !r) {
+                state.SkipWithError(r.error().c_str());
+                return;
+            }
+            const Allocations allocs{};
+            for (auto _ : state) {
+                benchmark::DoNotOptimize(search::find_package(s, "pkg0", {}, true, std::nullopt));
+            }
+            allocs.report(state);
+        }
+        BENCHMARK_CAPTURE(resolve, tree, tree);
+        BENCHMARK_CAPTURE(resolve, diamonds, diamonds);
+        BENCHMARK_CAPTURE(resolve, pc_mix, pc_mix);
+        BENCHMARK_CAPTURE(resolve, components, components);
+
+        /// @brief Checking a loaded package against a requirement it fails, for packages with more and more flags
+        ///
+        /// Nothing is added to a result, so the allocations should not
+        /// depend on how much data the package has.
+        void reject_components(benchmark::State & state) {
+            const Corpus corpus{{.packages = 1, .components = 8, .flags = static_cast<int>(state.range(0))}};
+            search::Session s{corpus.env()};
+            const std::vector<std::string> required{"c0", "missing"};
+            benchmark::DoNotOptimize(search::find_package(s, "pkg0", required, false, std::nullopt));
+            const Allocations allocs{};
+            for (auto _ : state) {
+                benchmark::DoNotOptimize(search::find_package(s, "pkg0", required, false, std::nullopt));
+            }
+            allocs.report(state);
+        }
+        BENCHMARK(reject_components)->ArgName("flags")->Arg(4)->Arg(64);
+
+        /// @brief Printing all of the flags of a resolved query
+        void print(benchmark::State & state, const CorpusOptions & opts) {
+            const Corpus corpus{opts};
+            search::Session s{corpus.env()};
+            auto && result = search::find_package(s, "pkg0", {}, true, std::nullopt);
+            if (!result) {
+                state.SkipWithError(result.error().c_str());
+                return;
+            }
+            const printer::Config conf{.defines = true,
+                                       .includes = true,
+                                       .cflags = true,
+                                       .libs_link = true,
+                                       .libs_search = true,
+                                       .libs_other = true};
+            std::FILE * out = std::fopen(null_device, "w");
+            const Allocations allocs{};
+            for (auto _ : state) {
+                printer::pkgconf(result.value(), conf, out);
+            }
+            allocs.report(state);
+            std::fclose(out);
+        }
+        BENCHMARK_CAPTURE(print, tree, tree);
+
+        void version_compare(benchmark::State & state) {
+            const Allocations allocs{};
+            for (auto _ : state) {
+                benchmark::DoNotOptimize(
+                    version::compare("1.2.3", version::Operator::lt, "1.2.10", version::Schema::simple));
+            }
+            allocs.report(state);
+        }
+        BENCHMARK(version_compare);
+
+    } // namespace
+} // namespace cps::bench
+
+BENCHMARK_MAIN();
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#pragma once
+
+#include "cps/env.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+/// @brief Synthetic packages for the benchmarks
+namespace cps::bench {
+
+    namespace fs = std::filesystem;
+
+    /// @brief The shape of a generated corpus
+    struct CorpusOptions {
+        /// @brief The total number of packages
+        int packages = 100;
+        /// @brief How many packages each package requires, at most
+        int fan_out = 4;
+        /// @brief The chance of each requirement being on a random later
+        /// package, rather than the package's own child in a tree. At 0 the
+        /// packages form a tree, as it rises more of them are shared
+        double diamond_density = 0.25;
+        /// @brief The number of components in each package, all of them default components
+        int components = 1;
+        /// @brief The number of compile flags, includes, definitions and link flags in each component
+        int flags = 4;
+        /// @brief The chance of each package that requires nothing being written as a pc file instead of a CPS file
+        ///
+        /// The requirements of pc files are not followed yet, so packages
+        /// with requirements are always written as CPS files.
+        double pc_fraction = 0.0;
+        /// @brief The seed for the choices above, so the same options always give the same corpus
+        uint32_t seed = 1;
+    };
+
+    /// @brief The text of a CPS file
+    /// @param requires_ The names of the packages required by the first component, which the others require
+    inline std::string make_cps(const std::string & name, const std::vector<std::string> & requires_,
+                                const CorpusOptions & opts) {
+        std::string reqs;
+        std::string comp_reqs;
+        for (auto && r : requires_) {
+            reqs += fmt::format("{}\"{}\": {{}}", reqs.empty() ? "" : ", ", r);
+            comp_reqs += fmt::format("{}\"{}\"", comp_reqs.empty() ? "" : ", ", r);
+        }
+
+        std::string components;
+        std::string defaults;
+        for (int c = 0; c < opts.components; ++c) {
+            std::string cflags;
+            std::string includes;
+            std::string defines;
+            std::string link_flags;
+            for (int f = 0; f < opts.flags; ++f) {
+                const char * sep = f == 0 ? "" : ", ";
+                cflags += fmt::format("{}\"-f{}-{}-{}\"", sep, name, c, f);
+                includes += fmt::format("{}\"@prefix@/include/c{}/f{}\"", sep, c, f);
+                defines += fmt::format("{}\"{}_C{}_F{}\": \"{}\"", sep, name, c, f, f);
+                link_flags += fmt::format("{}\"-Wl,--{}-{}-{}\"", sep, name, c, f);
+            }
+            components += fmt::format(R"({}
+        "c{}": {{
+            "type": "archive",
+            "location": "@prefix@/lib/lib{}-c{}.a",
+            "compile_flags": [{}],
+            "includes": {{"c": [{}]}},
+            "definitions": {{"c": {{{}}}}},
+            "link_flags": [{}],
+            "requires": [{}]
+        }})",
+                                      c == 0 ? "" : ",", c, name, c, cflags, includes, defines, link_flags,
+                                      c == 0 ? comp_reqs : "\":c0\"");
+            defaults += fmt::format("{}\"c{}\"", c == 0 ? "" : ", ", c);
+        }
+
+        return fmt::format(R"({{
+    "name": "{}",
+    "cps_version": "0.13.0",
+    "version": "1.0.0",
+    "prefix": "/opt/{}",
+    "requires": {{{}}},
+    "components": {{{}
+    }},
+    "default_components": [{}]
+}}
+)",
+                           name, name, reqs, components, defaults);
+    }
+
+    /// @brief The text of a pc file, with the same flags as make_cps would give one component
+    inline std::string make_pc(const std::string & name, const std::vector<std::string> & requires_,
+                               const CorpusOptions & opts) {
+        // The pc parser needs a version on the first requirement, and a
+        // space before each comma
+        std::string reqs;
+        for (auto && r : requires_) {
+            reqs += fmt::format("{}{} >= 1.0.0", reqs.empty() ? "" : " , ", r);
+        }
+        std::string cflags;
+        std::string libs;
+        for (int f = 0; f < opts.flags; ++f) {
+            // Nor can a property contain an `=`
+            cflags += fmt::format(" -f{}-{} -I${{includedir}}/f{} -D{}_F{}", name, f, f, name, f);
+            libs += fmt::format(" -Wl,--{}-{}", name, f);
+        }
+        return fmt::format(R"(prefix=/opt/{0}
+libdir=${{prefix}}/lib
+includedir=${{prefix}}/include
+
+Name: {0}
+Description: A generated package
+Version: 1.0.0
+{1}
+Cflags:{2}
+Libs: -L${{libdir}} -l{0}{3}
+)",
+                           name, reqs.empty() ? "" : "Requires: " + reqs, cflags, libs);
+    }
+
+    /// @brief A directory of generated packages, removed when the Corpus is destroyed
+    ///
+    /// Packages are named `pkg0` to `pkgN`, and only require packages with a
+    /// higher number, so `pkg0` depends on every other package, unless the
+    /// diamond density has left some unreachable.
+    class Corpus {
+      public:
+        explicit Corpus(const CorpusOptions & opts)
+            : dir{fs::temp_directory_path() / fmt::format("cps-bench-{}", std::random_device{}())} {
+            fs::create_directories(dir / "cps");
+            fs::create_directories(dir / "pkgconfig");
+
+            std::mt19937 rng{opts.seed};
+            std::uniform_real_distribution<double> chance{0.0, 1.0};
+            std::vector<bool> required(opts.packages, false);
+
+            for (int i = 0; i < opts.packages; ++i) {
+                std::vector<std::string> requires_;
+                for (int k = 1; k <= opts.fan_out; ++k) {
+                    int64_t dep = static_cast<int64_t>(i) * opts.fan_out + k;
+                    if (i + 1 < opts.packages && chance(rng) < opts.diamond_density) {
+                        dep = std::uniform_int_distribution<int64_t>{i + 1, opts.packages - 1}(rng);
+                    }
+                    if (dep >= opts.packages) {
+                        continue;
+                    }
+                    auto name = fmt::format("pkg{}", dep);
+                    if (std::find(requires_.begin(), requires_.end(), name) == requires_.end()) {
+                        required[dep] = true;
+                        requires_.emplace_back(std::move(name));
+                    }
+                }
+
+                const auto name = fmt::format("pkg{}", i);
+                names.emplace_back(name);
+                if (requires_.empty() && chance(rng) < opts.pc_fraction) {
+                    std::ofstream{dir / "pkgconfig" / (name + ".pc")} << make_pc(name, requires_, opts);
+                } else {
+                    std::ofstream{dir / "cps" / (name + ".cps")} << make_cps(name, requires_, opts);
+                }
+            }
+
+            for (int i = 0; i < opts.packages; ++i) {
+                if (!required[i]) {
+                    roots.emplace_back(names[i]);
+                }
+            }
+        }
+
+        ~Corpus() {
+            std::error_code ec;
+            fs::remove_all(dir, ec);
+        }
+
+        Corpus(const Corpus &) = delete;
+        Corpus & operator=(const Corpus &) = delete;
+
+        /// @brief An environment that finds only the packages in this corpus
+        Env env() const {
+            return Env{.cps_path = std::vector<fs::path>{dir / "cps"},
+                       .pc_path = std::vector<fs::path>{dir / "pkgconfig"}};
+        }
+
+        const fs::path dir;
+        /// @brief Every package, in order
+        std::vector<std::string> names;
+        /// @brief The packages no other package requires
+        std::vector<std::string> roots;
+    };
+
+} // namespace cps::bench
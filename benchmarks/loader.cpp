@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "corpus.hpp"
+
+#include "cps/loader.hpp"
+#include "cps/pc_compat/pc_loader.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace cps::loader::bench {
+    namespace {
+
+        using cps::bench::CorpusOptions;
+
+        const std::vector<std::string> requires_{"dep0", "dep1", "dep2", "dep3"};
+
+        /// @brief Parse a CPS file with range(0) flags in each of range(1) components
+        void BM_load_cps(benchmark::State & state) {
+            const CorpusOptions opts{.components = static_cast<int>(state.range(1)),
+                                     .flags = static_cast<int>(state.range(0))};
+            const std::string text = cps::bench::make_cps("bench", requires_, opts);
+            for (auto _ : state) {
+                std::istringstream in{text};
+                benchmark::DoNotOptimize(load(in, "/opt/bench/lib/cps/bench.cps"));
+            }
+            state.SetBytesProcessed(state.iterations() * text.size());
+        }
+        BENCHMARK(BM_load_cps)->ArgsProduct({{1, 16, 256}, {1, 8}});
+
+        /// @brief Parse a pc file with range(0) of each kind of flag
+        void BM_load_pc(benchmark::State & state) {
+            const CorpusOptions opts{.flags = static_cast<int>(state.range(0))};
+            const std::string text = cps::bench::make_pc("bench", requires_, opts);
+            for (auto _ : state) {
+                std::istringstream in{text};
+                benchmark::DoNotOptimize(pc_compat::load(in, "/opt/bench/lib/pkgconfig/bench.pc"));
+            }
+            state.SetBytesProcessed(state.iterations() * text.size());
+        }
+        BENCHMARK(BM_load_pc)->Arg(1)->Arg(16)->Arg(256);
+
+    } // namespace
+} // namespace cps::loader::bench
+
+BENCHMARK_MAIN();
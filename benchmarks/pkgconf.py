@@ -0,0 +1,259 @@
+#!/usr/bin/env python
+# SPDX-License-Identifier: MIT
+# Copyright © 2025 Dylan Baker
+
+"""Compare `cps-config pkg-config` against pkgconf on the same pc files.
+
+Generates trees of pc files, then runs `--cflags --libs` on them with both
+tools, reporting the cold and warm latency of a single query, the throughput
+of back to back queries, the syscalls made, and the peak RSS of each.
+
+A cold query is the first one run on a newly written corpus, with each tool
+getting its own copy. With --drop-caches (which needs root) the page cache is
+also dropped first, otherwise the files will still be in it.
+
+cps-config does not yet follow the Requires of pc files, so the generated
+packages have none, and each query instead asks for several packages at once.
+
+Exits with 77, which meson treats as a skip, if pkgconf cannot be found.
+"""
+
+from __future__ import annotations
+
+import argparse
+import dataclasses
+import os
+import pathlib
+import random
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+import typing
+
+if typing.TYPE_CHECKING:
+
+    class Arguments(typing.Protocol):
+
+        cps_config: str
+        pkg_config: str | None
+        runs: int
+        duration: float
+        drop_caches: bool
+
+
+SKIP = 77
+
+
+@dataclasses.dataclass
+class CorpusOptions:
+
+    name: str
+    # The number of packages written
+    packages: int
+    # The number of packages asked for by each query
+    query: int
+    # The number of cflags and libs in each package
+    flags: int = 4
+    seed: int = 1
+
+
+CORPORA = [
+    CorpusOptions('single', packages=1, query=1),
+    CorpusOptions('few', packages=16, query=8),
+    CorpusOptions('many', packages=512, query=64),
+    CorpusOptions('wide', packages=64, query=16, flags=64),
+]
+
+
+@dataclasses.dataclass
+class Tool:
+
+    name: str
+    command: list[str]
+
+
+@dataclasses.dataclass
+class Measurement:
+
+    cold: float
+    warm: float
+    throughput: float
+    syscalls: int | None
+    rss: int | None
+    output: str
+
+
+def make_pc(name: str, opts: CorpusOptions) -> str:
+    cflags = ''.join(f' -f{name}-{f} -I${{includedir}}/f{f} -D{name}_F{f}' for f in range(opts.flags))
+    libs = ''.join(f' -Wl,--{name}-{f}' for f in range(opts.flags))
+    return (f'prefix=/opt/{name}\n'
+            'libdir=${prefix}/lib\n'
+            'includedir=${prefix}/include\n'
+            '\n'
+            f'Name: {name}\n'
+            'Description: A generated package\n'
+            'Version: 1.0.0\n'
+            f'Cflags:{cflags}\n'
+            f'Libs: -L${{libdir}} -l{name}{libs}\n')
+
+
+def write_corpus(opts: CorpusOptions, dest: pathlib.Path) -> list[str]:
+    """Write the packages to dest, returning the packages to query."""
+    dest.mkdir(parents=True)
+    names = [f'pkg{i}' for i in range(opts.packages)]
+    for n in names:
+        (dest / f'{n}.pc').write_text(make_pc(n, opts))
+    return random.Random(opts.seed).sample(names, opts.query)
+
+
+def drop_caches() -> None:
+    os.sync()
+    with open('/proc/sys/vm/drop_caches', 'w') as f:
+        f.write('3\n')
+
+
+def run(command: list[str], env: dict[str, str]) -> tuple[float, str]:
+    """Run a command, returning the wall time and the output."""
+    start = time.perf_counter()
+    proc = subprocess.run(command, env=env, capture_output=True)
+    elapsed = time.perf_counter() - start
+    if proc.returncode != 0:
+        raise RuntimeError(f'{" ".join(command)} failed with {proc.returncode}: {proc.stderr.decode().strip()}')
+    return elapsed, proc.stdout.decode().strip()
+
+
+def gnu_time() -> str | None:
+    time_ = shutil.which('time')
+    if time_ is None:
+        return None
+    proc = subprocess.run([time_, '--version'], capture_output=True, text=True)
+    return time_ if 'GNU' in proc.stdout + proc.stderr else None
+
+
+def peak_rss(command: list[str], env: dict[str, str]) -> int | None:
+    """The peak RSS of a command in KiB.
+
+    The ru_maxrss of a child of Python includes the RSS of Python itself,
+    which it had before exec, so GNU time is used to start the command from
+    a smaller parent.
+    """
+    time_ = gnu_time()
+    if time_ is None:
+        return None
+    with tempfile.NamedTemporaryFile('r') as f:
+        subprocess.run([time_, '-f', '%M', '-o', f.name] + command,
+                       env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, check=True)
+        return int(f.read().split()[-1])
+
+
+def count_syscalls(command: list[str], env: dict[str, str]) -> int | None:
+    strace = shutil.which('strace')
+    if strace is None:
+        return None
+    with tempfile.NamedTemporaryFile('r') as f:
+        subprocess.run([strace, '-f', '-c', '-qq', '-o', f.name] + command,
+                       env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, check=True)
+        for line in f:
+            fields = line.split()
+            if fields and fields[-1] == 'total':
+                # % time, seconds, usecs/call, calls, [errors,] total
+                return int(fields[3])
+    return None
+
+
+def measure(args: Arguments, tool: Tool, opts: CorpusOptions, root: pathlib.Path) -> Measurement:
+    colds: list[float] = []
+    output = ''
+    query: list[str] = []
+    env: dict[str, str] = {}
+    for i in range(args.runs):
+        corpus = root / f'{tool.name}-{i}'
+        query = write_corpus(opts, corpus)
+        # Both tools search PKG_CONFIG_PATH before their defaults, and
+        # cps-config has nothing to find in CPS_PATH
+        env = dict(os.environ, PKG_CONFIG_PATH=str(corpus), CPS_PATH=str(root / 'empty'))
+        if args.drop_caches:
+            drop_caches()
+        elapsed, output = run(tool.command + query, env)
+        colds.append(elapsed)
+
+    command = tool.command + query
+    warms: list[float] = []
+    for _ in range(args.runs):
+        elapsed, _ = run(command, env)
+        warms.append(elapsed)
+
+    done = 0
+    start = time.perf_counter()
+    while (elapsed := time.perf_counter() - start) < args.duration:
+        run(command, env)
+        done += 1
+
+    return Measurement(
+        cold=statistics.median(colds),
+        warm=statistics.median(warms),
+        throughput=done / elapsed,
+        syscalls=count_syscalls(command, env),
+        rss=peak_rss(command, env),
+        output=output,
+    )
+
+
+def report(opts: CorpusOptions, results: dict[str, Measurement]) -> None:
+    print(f'\n{opts.name}: {opts.query} of {opts.packages} packages, {opts.flags} flags each')
+    print(f'  {"":<12} {"cold ms":>10} {"warm ms":>10} {"queries/s":>10} {"syscalls":>10} {"RSS KiB":>10}')
+    for name, m in results.items():
+        syscalls = '-' if m.syscalls is None else str(m.syscalls)
+        rss = '-' if m.rss is None else str(m.rss)
+        print(f'  {name:<12} {m.cold * 1000:>10.2f} {m.warm * 1000:>10.2f} {m.throughput:>10.1f} '
+              f'{syscalls:>10} {rss:>10}')
+
+    # The order and deduplication of flags may differ, but not what they are
+    outputs = {name: set(m.output.split()) for name, m in results.items()}
+    first, *rest = outputs.items()
+    for name, flags in rest:
+        if flags != first[1]:
+            print(f'  warning: {name} and {first[0]} do not print the same flags:',
+                  ' '.join(sorted(flags ^ first[1])), file=sys.stderr)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='Compare cps-config against pkgconf')
+    parser.add_argument('cps_config', help='The compiled cps-config binary')
+    parser.add_argument('--pkg-config', default=None,
+                        help='The pkgconf or pkg-config binary to compare against, found in PATH by default')
+    parser.add_argument('--runs', type=int, default=11, help='The number of cold and warm queries to take the median of')
+    parser.add_argument('--duration', type=float, default=1.0,
+                        help='The number of seconds to measure throughput over')
+    parser.add_argument('--drop-caches', action='store_true', help='Drop the page cache before cold queries (needs root)')
+    args: Arguments = parser.parse_args()
+
+    if args.pkg_config:
+        pkg_config = shutil.which(args.pkg_config)
+    else:
+        pkg_config = shutil.which('pkgconf') or shutil.which('pkg-config')
+    if pkg_config is None:
+        print(f'{args.pkg_config or "pkgconf"} was not found, skipping')
+        sys.exit(SKIP)
+
+    tools = [
+        Tool('cps-config', [args.cps_config, 'pkg-config', '--cflags', '--libs']),
+        Tool(pathlib.Path(pkg_config).name, [pkg_config, '--cflags', '--libs']),
+    ]
+    if shutil.which('strace') is None:
+        print('strace was not found, syscalls will not be counted')
+    if gnu_time() is None:
+        print('GNU time was not found, RSS will not be measured')
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        for opts in CORPORA:
+            root = pathlib.Path(tmpdir) / opts.name
+            (root / 'empty').mkdir(parents=True)
+            report(opts, {t.name: measure(args, t, opts, root) for t in tools})
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/printer.hpp"
+#include "cps/search.hpp"
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace cps::printer::bench {
+    namespace {
+
+        constexpr const char * null_device =
+#ifdef _WIN32
+            "NUL"
+#else
+            "/dev/null"
+#endif
+            ;
+
+        /// @brief Create a result with `count` components, each in its own package, with one entry in each field
+        /// @param all_languages Set the compile flags for every language, like `*` does, rather than only C
+        search::Result make_result(int64_t count, bool all_languages = false) {
+            search::Result r{};
+            r.version = "1.0.0";
+            const std::vector<loader::KnownLanguages> langs =
+                all_languages ? std::vector{loader::KnownLanguages::c, loader::KnownLanguages::cxx,
+                                            loader::KnownLanguages::fortran}
+                              : std::vector{loader::KnownLanguages::c};
+            for (int64_t i = 0; i < count; ++i) {
+                loader::Component comp{};
+                comp.type = loader::Type::archive;
+                comp.location = loader::PrefixPath{fmt::format("@prefix@/lib/libpkg{}.a", i)};
+                for (auto && lang : langs) {
+                    comp.compile_flags[lang].emplace_back(fmt::format("-fflag-{}", i));
+                    comp.includes[lang].emplace_back("@prefix@/include");
+                    comp.definitions[lang].emplace_back(fmt::format("DEFINE_{}", i), "1");
+                }
+                switch (i % 3) {
+                case 0:
+                    comp.link_flags.emplace_back(
+                        loader::LinkFlag{loader::LinkFlagType::search_dir, fmt::format("/opt/pkg{}/lib", i)});
+                    break;
+                case 1:
+                    comp.link_flags.emplace_back(
+                        loader::LinkFlag{loader::LinkFlagType::library, fmt::format("pkg{}", i)});
+                    break;
+                default:
+                    comp.link_flags.emplace_back(
+                        loader::LinkFlag{loader::LinkFlagType::other, fmt::format("-Wl,--flag-{}", i)});
+                    break;
+                }
+                comp.link_libraries.emplace_back(fmt::format("lib{}", i));
+
+                auto package = std::make_shared<loader::Package>();
+                package->name = fmt::format("pkg{}", i);
+                package->prefix = fmt::format("/opt/pkg{}", i);
+                auto && stored = package->components.emplace("default", std::move(comp)).first->second;
+                r.prefixes.emplace_back(package->prefix);
+                r.entries.emplace_back(search::Result::Entry{.package = std::move(package),
+                                                             .component = &stored,
+                                                             .prefix = r.prefixes.size() - 1,
+                                                             .link_only = false});
+            }
+            return r;
+        }
+
+        void run(benchmark::State & state, const search::Result & r, const Config & conf) {
+            std::FILE * out = std::fopen(null_device, "w");
+            for (auto _ : state) {
+                pkgconf(r, conf, out);
+            }
+            std::fclose(out);
+            // Every field has range(0) entries
+            state.SetItemsProcessed(state.iterations() * state.range(0));
+        }
+
+        void BM_pkgconf_cflags(benchmark::State & state) {
+            run(state, make_result(state.range(0)), Config{.defines = true, .includes = true, .cflags = true});
+        }
+        BENCHMARK(BM_pkgconf_cflags)->RangeMultiplier(10)->Range(10, 10'000);
+
+        void BM_pkgconf_libs(benchmark::State & state) {
+            run(state, make_result(state.range(0)), Config{.libs_link = true, .libs_search = true, .libs_other = true});
+        }
+        BENCHMARK(BM_pkgconf_libs)->RangeMultiplier(10)->Range(10, 10'000);
+
+        void BM_pkgconf_all(benchmark::State & state) {
+            run(state, make_result(state.range(0)), Config{.defines = true,
+                              .includes = true,
+                              .cflags = true,
+                              .libs_link = true,
+                              .libs_search = true,
+                              .libs_other = true});
+        }
+        BENCHMARK(BM_pkgconf_all)->RangeMultiplier(10)->Range(10, 10'000);
+
+        void BM_pkgconf_all_languages(benchmark::State & state) {
+            // The C flags are shared by the other languages, like they would be when set with `*`
+            run(state, make_result(state.range(0), true),
+                Config{.defines = true,
+                       .includes = true,
+                       .cflags = true,
+                       .libs_link = true,
+                       .libs_search = true,
+                       .libs_other = true,
+                       .languages = {loader::KnownLanguages::c, loader::KnownLanguages::cxx,
+                                     loader::KnownLanguages::fortran}});
+        }
+        BENCHMARK(BM_pkgconf_all_languages)->RangeMultiplier(10)->Range(10, 10'000);
+
+    } // namespace
+} // namespace cps::printer::bench
+
+BENCHMARK_MAIN();
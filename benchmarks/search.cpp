@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "corpus.hpp"
+
+#include "cps/search.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace cps::search::bench {
+    namespace {
+
+        using cps::bench::Corpus;
+        using cps::bench::CorpusOptions;
+
+        /// @brief Resolve the whole corpus from its first package, with range(0) packages
+        ///
+        /// A new Session is used for each iteration, so this includes finding
+        /// and loading every file.
+        void find_package_cold(benchmark::State & state, CorpusOptions opts) {
+            opts.packages = static_cast<int>(state.range(0));
+            const Corpus corpus{opts};
+            for (auto _ : state) {
+                Session session{corpus.env()};
+                benchmark::DoNotOptimize(find_package(session, "pkg0", {}, true, std::nullopt));
+            }
+            state.SetItemsProcessed(state.iterations() * state.range(0));
+        }
+        BENCHMARK_CAPTURE(find_package_cold, tree, CorpusOptions{.diamond_density = 0})
+            ->RangeMultiplier(4)
+            ->Range(16, 1024);
+        BENCHMARK_CAPTURE(find_package_cold, diamonds, CorpusOptions{.diamond_density = 0.5})
+            ->RangeMultiplier(4)
+            ->Range(16, 1024);
+        BENCHMARK_CAPTURE(find_package_cold, pc_mix, CorpusOptions{.diamond_density = 0, .pc_fraction = 0.5})
+            ->RangeMultiplier(4)
+            ->Range(16, 1024);
+        BENCHMARK_CAPTURE(find_package_cold, components, CorpusOptions{.diamond_density = 0, .components = 8})
+            ->RangeMultiplier(4)
+            ->Range(16, 1024);
+
+        /// @brief Resolve the whole corpus with every file already loaded, as in batch mode
+        void find_package_warm(benchmark::State & state, CorpusOptions opts) {
+            opts.packages = static_cast<int>(state.range(0));
+            const Corpus corpus{opts};
+            Session session{corpus.env()};
+            for (auto _ : state) {
+                benchmark::DoNotOptimize(find_package(session, "pkg0", {}, true, std::nullopt));
+            }
+            state.SetItemsProcessed(state.iterations() * state.range(0));
+        }
+        BENCHMARK_CAPTURE(find_package_warm, diamonds, CorpusOptions{.diamond_density = 0.5})
+            ->RangeMultiplier(4)
+            ->Range(16, 256);
+
+        /// @brief Many roots that share parts of their dependency graphs
+        const Corpus & shared_corpus() {
+            static const Corpus c{CorpusOptions{.packages = 512, .diamond_density = 0.75}};
+            return c;
+        }
+
+        std::vector<Query> make_queries() {
+            std::vector<Query> queries;
+            for (auto && name : shared_corpus().names) {
+                queries.emplace_back(Query{name});
+                if (queries.size() == 64) {
+                    break;
+                }
+            }
+            return queries;
+        }
+
+        /// @brief Resolve every root one after another, as a baseline
+        void BM_find_package_sequential(benchmark::State & state) {
+            const auto queries = make_queries();
+            for (auto _ : state) {
+                Session session{shared_corpus().env()};
+                for (auto && q : queries) {
+                    benchmark::DoNotOptimize(
+                        find_package(session, q.name, q.components, q.default_components, q.prefix_variable));
+                }
+            }
+            state.SetItemsProcessed(state.iterations() * queries.size());
+        }
+        BENCHMARK(BM_find_package_sequential)->UseRealTime();
+
+        /// @brief Resolve every root at once, with range(0) threads
+        void BM_find_packages(benchmark::State & state) {
+            const auto queries = make_queries();
+            for (auto _ : state) {
+                // A new session each time, so that every file has to be loaded
+                Session session{shared_corpus().env()};
+                benchmark::DoNotOptimize(find_packages(session, queries, static_cast<size_t>(state.range(0))));
+            }
+            state.SetItemsProcessed(state.iterations() * queries.size());
+        }
+        BENCHMARK(BM_find_packages)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+
+    } // namespace
+} // namespace cps::search::bench
+
+BENCHMARK_MAIN();
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/version.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cps::version::bench {
+    namespace {
+
+        /// @brief Pairs of versions, from trivial to long
+        const std::vector<std::pair<std::string, std::string>> versions{
+            {"1", "2"},
+            {"1.0.0", "1.0.0"},
+            {"1.2.3", "1.2.10"},
+            {"1.2", "1.2.0.0"},
+            {"1.0.0-rc1", "1.0.0-rc2"},
+            {"1.0.0+build5", "1.0.0+build6"},
+            {"1.2.3.4.5.6.7.8.9.10.11.12", "1.2.3.4.5.6.7.8.9.10.11.13"},
+        };
+
+        /// @brief Compare the range(0)th pair of versions, only the simple schema is implemented
+        void BM_compare_simple(benchmark::State & state) {
+            auto && [left, right] = versions[state.range(0)];
+            state.SetLabel(left + " < " + right);
+            for (auto _ : state) {
+                benchmark::DoNotOptimize(compare(left, Operator::lt, right, Schema::simple));
+            }
+        }
+        BENCHMARK(BM_compare_simple)->DenseRange(0, static_cast<int64_t>(versions.size()) - 1);
+
+    } // namespace
+} // namespace cps::version::bench
+
+BENCHMARK_MAIN();
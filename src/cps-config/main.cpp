@@ -3,17 +3,29 @@
 // SPDX-License-Identifier: MIT
 
 #include "cps/config.hpp"
+#include "cps/depfile.hpp"
 #include "cps/env.hpp"
+#include "cps/lockfile.hpp"
 #include "cps/printer.hpp"
 #include "cps/search.hpp"
+#include "cps/trace.hpp"
+#include "cps/version.hpp"
 
 #include <CLI/CLI.hpp>
 #include <fmt/core.h>
 #include <fmt/format.h>
+#include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace cps_config {
@@ -25,6 +37,121 @@ namespace cps_config {
         static auto Success() { return ProgramOutput{}; }
     };
 
+    /// @brief Run a single batch query
+    /// @param line A JSON object with a required `package` string, and optional `components` list and
+    /// `prefix_variable` string
+    tl::expected<cps::search::Result, std::string> batch_query(cps::search::Session & session,
+                                                               const std::string & line) {
+        const nlohmann::json query = nlohmann::json::parse(line, nullptr, false);
+        if (query.is_discarded() || !query.is_object()) {
+            return tl::unexpected("query is not a JSON object");
+        }
+
+        auto && package = query.find("package");
+        if (package == query.end() || !package->is_string()) {
+            return tl::unexpected("query requires a 'package' string");
+        }
+
+        std::vector<std::string> components;
+        if (auto && c = query.find("components"); c != query.end()) {
+            if (!c->is_array()) {
+                return tl::unexpected("'components' must be a list of strings");
+            }
+            for (auto && v : *c) {
+                if (!v.is_string()) {
+                    return tl::unexpected("'components' must be a list of strings");
+                }
+                components.emplace_back(v.get<std::string>());
+            }
+        }
+
+        std::optional<std::string> prefix_variable = std::nullopt;
+        if (auto && p = query.find("prefix_variable"); p != query.end()) {
+            if (!p->is_string()) {
+                return tl::unexpected("'prefix_variable' must be a string");
+            }
+            prefix_variable = p->get<std::string>();
+        }
+
+        return cps::search::find_package(session, package->get_ref<const std::string &>(), components,
+                                         components.empty(), prefix_variable);
+    }
+
+    /// @brief Writes the counters of a Session to stderr when it goes out of scope, if enabled
+    struct StatsPrinter {
+        const cps::search::Session & session;
+        const bool enabled;
+
+        ~StatsPrinter() {
+            if (enabled) {
+                fmt::print(stderr, "{}", cps::search::to_string(session.stats()));
+            }
+        }
+    };
+
+    /// @brief A version a package must have, from --atleast-version and friends
+    struct VersionCheck {
+        cps::version::Operator op;
+        /// @brief How the operator is written in messages
+        std::string_view symbol;
+        std::string version;
+    };
+
+    /// @brief Check that a package exists, and has the required versions, without finding its flags
+    /// @return Why the package failed a check, if it did
+    std::optional<std::string> check_package(cps::search::Session & session, const cps::search::Query & query,
+                                             const std::vector<VersionCheck> & versions, bool follow_requires) {
+        auto && found = cps::search::probe_package(session, query.name, query.components, follow_requires);
+        if (!found) {
+            return found.error();
+        }
+        auto && p = *found.value();
+        for (auto && check : versions) {
+            if (!p.version) {
+                return fmt::format("Requested '{} {} {}' but {} does not specify a version", query.name, check.symbol,
+                                   check.version, query.name);
+            }
+            auto && passed = cps::version::compare(p.version.value(), check.op, check.version, p.version_schema);
+            if (!passed) {
+                return passed.error();
+            }
+            if (!passed.value()) {
+                return fmt::format("Requested '{} {} {}' but version of {} is {}", query.name, check.symbol,
+                                   check.version, query.name, p.version.value());
+            }
+        }
+        return std::nullopt;
+    }
+
+    /// @brief Answer queries read from stdin, one per line, until it is closed
+    ///
+    /// Each result is written as a single line in the same format as `flags --format=json`, or an object with an
+    /// `error` key if the query failed. Loaded files are kept between queries.
+    int batch(cps::Env env, bool stats) {
+        cps::search::Session session{std::move(env)};
+        const StatsPrinter stats_printer{session, stats};
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            // A file which cannot be parsed throws, and the exception is
+            // cached for its package, so each query for it fails the same way
+            try {
+                if (auto && result = batch_query(session, line)) {
+                    cps::printer::json(result.value());
+                } else {
+                    fmt::print("{}\n", nlohmann::json{{"error", result.error()}}.dump());
+                }
+            } catch (const std::exception & ex) {
+                fmt::print("{}\n", nlohmann::json{{"error", ex.what()}}.dump());
+            }
+            // The caller is likely waiting on this result before sending the next query
+            std::fflush(stdout);
+        }
+        return 0;
+    }
+
     ProgramOutput run(int argc, char * argv[]) {
         using namespace std::string_literals;
 
@@ -32,8 +159,24 @@ namespace cps_config {
         std::vector<std::string> components;
         std::string format{"pkgconf"};
         std::vector<std::string> package_names;
+        std::vector<std::string> languages;
         bool errors_to_stdout = false;
+        bool no_deduplicate = false;
+        bool keep_system_cflags = false;
+        bool keep_system_libs = false;
+        bool hash = false;
+        bool exists = false;
+        bool no_requires = false;
+        std::optional<std::string> atleast_version = std::nullopt;
+        std::optional<std::string> exact_version = std::nullopt;
+        std::optional<std::string> max_version = std::nullopt;
         std::optional<std::string> prefix_variable = std::nullopt;
+        std::optional<std::string> trace_file = std::nullopt;
+        std::optional<std::string> depfile = std::nullopt;
+        std::optional<std::string> depfile_target = std::nullopt;
+        std::optional<std::string> lockfile = std::nullopt;
+        std::string lock_output;
+        bool stats = false;
 
         // read enviroment variables
         auto env = cps::get_env();
@@ -91,22 +234,96 @@ Support:
             subcommand->add_flag("--prefix-variable", prefix_variable,
                                  "set value of @prefix@ instead of infering it from where the cps file was found");
             subcommand->add_flag("--modversion", conf.mod_version, "print the specified module's version to stdout");
+            subcommand->add_flag("--exists", exists,
+                                 "print nothing, and exit with success if all of the packages can be found");
+            subcommand->add_option("--atleast-version", atleast_version,
+                                   "print nothing, and exit with success if the packages are at least this version");
+            subcommand->add_option("--exact-version", exact_version,
+                                   "print nothing, and exit with success if the packages are exactly this version");
+            subcommand->add_option("--max-version", max_version,
+                                   "print nothing, and exit with success if the packages are at most this version");
+            subcommand->add_flag("--no-requires", no_requires,
+                                 "with --exists or a version check, only check the packages named, not the packages "
+                                 "they require");
+            subcommand->add_flag("--hash", hash,
+                                 "print a digest of the packages found and the files they were loaded from instead of "
+                                 "flags, which changes whenever the flags would");
+            subcommand
+                ->add_option("--language", languages,
+                             "print compile flags for the given language(s), default c. If more than one is given, or "
+                             "`all`, each language is printed on its own line")
+                ->check(CLI::IsMember({"c", "c++", "cxx", "fortran", "all"}));
+            subcommand->add_flag("--no-deduplicate", no_deduplicate,
+                                 "print every argument of every component, even if it has already been printed, "
+                                 "rather than removing repeated include directories, definitions, compile flags, "
+                                 "libraries and library directories");
+            subcommand->add_flag("--keep-system-cflags", keep_system_cflags,
+                                 "print include directories the compiler searches anyway, also enabled by "
+                                 "PKG_CONFIG_ALLOW_SYSTEM_CFLAGS");
+            subcommand->add_flag("--keep-system-libs", keep_system_libs,
+                                 "print library directories the linker searches anyway, also enabled by "
+                                 "PKG_CONFIG_ALLOW_SYSTEM_LIBS");
             subcommand->add_flag("--print-errors", conf.print_errors,
                                  "enables debug messages when errors are encountered");
             subcommand->add_flag("--errors-to-stdout", errors_to_stdout, "print errors to stdout instead of stderr");
+            subcommand->add_option("--depfile", depfile,
+                                   "write a Makefile rule to the given file listing every file read and every "
+                                   "directory searched, or its nearest existing parent if it does not exist, so the "
+                                   "query can be rerun when one of them changes");
+            subcommand
+                ->add_option("--depfile-target", depfile_target,
+                             "the target of the rule written by --depfile, by default the depfile itself")
+                ->needs("--depfile");
+            subcommand->add_option("--lockfile", lockfile,
+                                   "answer from a lockfile written by `cps-config lock` instead of searching, unless "
+                                   "it does not have a package or a file it was written from has changed");
             subcommand->add_option("packages", package_names, "search for the specified packages")->required();
         };
 
+        auto add_instrumentation_options = [&](CLI::App * subcommand) {
+            subcommand->add_flag("--stats", stats,
+                                 "print counts of the files searched for and loaded to stderr, also enabled by "
+                                 "CPS_CONFIG_DEBUG_SPEW");
+            subcommand->add_option("--trace", trace_file,
+                                   "write a Chrome trace of how long each step took to the given file, which can be "
+                                   "viewed in chrome://tracing or https://ui.perfetto.dev. Overrides CPS_CONFIG_TRACE");
+        };
+
         // cps-config flags
         auto flags_command = app.add_subcommand("flags", "get flags used to compile and link a package");
         add_common_options(flags_command);
+        add_instrumentation_options(flags_command);
         flags_command->add_option<std::vector<std::string>>("--component"s, components,
                                                             "look for the specified component(s)"s);
-        flags_command->add_flag("--format", format, "output format");
+        flags_command->add_flag("--format", format, "output format, one of `pkgconf` (the default) or `json`");
 
         // pkg-config compatibility mode
         auto pkg_config_command = app.add_subcommand("pkg-config", "pkg-config compatibility mode");
         add_common_options(pkg_config_command);
+        add_instrumentation_options(pkg_config_command);
+
+        // lock mode
+        auto lock_command = app.add_subcommand(
+            "lock", "find packages, and write their flags and the files they came from to a lockfile for --lockfile");
+        add_instrumentation_options(lock_command);
+        lock_command->add_option("-o,--output", lock_output, "the lockfile to write")->required();
+        lock_command->add_option<std::vector<std::string>>("--component"s, components,
+                                                           "look for the specified component(s)"s);
+        lock_command->add_flag("--prefix-variable", prefix_variable,
+                               "set value of @prefix@ instead of infering it from where the cps file was found");
+        lock_command->add_flag("--keep-system-cflags", keep_system_cflags,
+                               "keep include directories the compiler searches anyway, also enabled by "
+                               "PKG_CONFIG_ALLOW_SYSTEM_CFLAGS");
+        lock_command->add_flag("--keep-system-libs", keep_system_libs,
+                               "keep library directories the linker searches anyway, also enabled by "
+                               "PKG_CONFIG_ALLOW_SYSTEM_LIBS");
+        lock_command->add_flag("--errors-to-stdout", errors_to_stdout, "print errors to stdout instead of stderr");
+        lock_command->add_option("packages", package_names, "search for the specified packages")->required();
+
+        // batch mode
+        auto batch_command = app.add_subcommand(
+            "batch", "read JSON queries from stdin, one per line, and write a JSON result for each on its own line");
+        add_instrumentation_options(batch_command);
 
         try {
             app.parse(argc, argv);
@@ -117,19 +334,169 @@ Support:
                 .retval = retval, .debug_output = error_out.str(), .errors_to_stdout = errors_to_stdout};
         }
 
-        auto && p =
-            cps::search::find_package(package_names.front(), components, components.empty(), env, prefix_variable);
-        if (!p) {
-            return ProgramOutput{.retval = 1,
-                                 .debug_output = conf.print_errors ? fmt::format("{}\n", p.error()) : "",
-                                 .errors_to_stdout = errors_to_stdout};
+        if (trace_file) {
+            env.trace_file = trace_file.value();
+        }
+        if (env.trace_file) {
+            cps::trace::start(env.trace_file.value());
+        }
+        cps::trace::Span span{"cps-config"};
+        stats |= env.debug_spew;
+
+        if (batch_command->parsed()) {
+            return ProgramOutput{.retval = batch(std::move(env), stats)};
+        }
+
+        if (!languages.empty()) {
+            conf.languages.clear();
+            for (auto && l : languages) {
+                if (l == "all") {
+                    conf.languages = {cps::loader::KnownLanguages::c, cps::loader::KnownLanguages::cxx,
+                                      cps::loader::KnownLanguages::fortran};
+                    break;
+                }
+                // Already validated by CLI11. Each language is printed once, however often it is given
+                auto && lang = cps::loader::string_to_language(l).value();
+                if (std::find(conf.languages.begin(), conf.languages.end(), lang) == conf.languages.end()) {
+                    conf.languages.emplace_back(lang);
+                }
+            }
+        }
+
+        env.keep_system_cflags |= keep_system_cflags;
+        env.keep_system_libs |= keep_system_libs;
+        // Hashing every file loaded is only worth it when the digests are used
+        env.digests = hash || lock_command->parsed();
+        std::vector<cps::search::Query> queries;
+        queries.reserve(package_names.size());
+        for (auto && name : package_names) {
+            queries.emplace_back(cps::search::Query{name, components, components.empty(), prefix_variable});
+        }
+
+        std::vector<VersionCheck> version_checks;
+        if (atleast_version) {
+            version_checks.emplace_back(VersionCheck{cps::version::Operator::ge, ">=", atleast_version.value()});
+        }
+        if (exact_version) {
+            version_checks.emplace_back(VersionCheck{cps::version::Operator::eq, "=", exact_version.value()});
+        }
+        if (max_version) {
+            version_checks.emplace_back(VersionCheck{cps::version::Operator::le, "<=", max_version.value()});
+        }
+        if (exists || !version_checks.empty()) {
+            // Only the packages themselves are needed, not their flags
+            cps::search::Session session{std::move(env)};
+            const StatsPrinter stats_printer{session, stats};
+            for (auto && q : queries) {
+                if (auto && failed = check_package(session, q, version_checks, !no_requires)) {
+                    return ProgramOutput{.retval = 1,
+                                         .debug_output = conf.print_errors ? failed.value() + "\n" : "",
+                                         .errors_to_stdout = errors_to_stdout};
+                }
+            }
+            return ProgramOutput::Success();
+        }
+
+        cps::search::Session session{std::move(env)};
+        const StatsPrinter stats_printer{session, stats};
+
+        // The lockfile is only used if it has every query, otherwise they are all searched for. Why it
+        // is not used is printed with --stats, which debug spew also sets
+        std::vector<tl::expected<cps::search::Result, std::string>> found;
+        std::vector<std::filesystem::path> inputs;
+        if (lockfile) {
+            inputs.emplace_back(*lockfile);
+            if (auto && lock = cps::lockfile::read(*lockfile)) {
+                for (auto && q : queries) {
+                    auto && locked = cps::lockfile::find(lock.value(), q, session);
+                    if (!locked) {
+                        if (stats) {
+                            fmt::print(stderr, "not using lockfile: {}\n", locked.error());
+                        }
+                        found.clear();
+                        break;
+                    }
+                    found.emplace_back(std::move(locked.value()));
+                }
+                if (!found.empty()) {
+                    inputs.insert(inputs.end(), lock->files.begin(), lock->files.end());
+                }
+            } else if (stats) {
+                fmt::print(stderr, "not using lockfile: {}\n", lock.error());
+            }
+        }
+
+        if (found.empty()) {
+            if (queries.size() == 1) {
+                auto && q = queries.front();
+                found.emplace_back(cps::search::find_package(session, q.name, q.components, q.default_components,
+                                                             q.prefix_variable));
+            } else {
+                found = cps::search::find_packages(session, queries);
+            }
+            auto && searched = session.inputs();
+            inputs.insert(inputs.end(), searched.begin(), searched.end());
+        }
+
+        // Written even if a package was not found, as adding it is a change
+        // the caller wants to rerun for
+        if (depfile) {
+            if (auto && written = cps::depfile::write(*depfile, depfile_target.value_or(*depfile), inputs); !written) {
+                return ProgramOutput{
+                    .retval = 1, .debug_output = written.error() + "\n", .errors_to_stdout = errors_to_stdout};
+            }
+        }
+        for (auto && p : found) {
+            if (!p) {
+                return ProgramOutput{.retval = 1,
+                                     .debug_output = conf.print_errors || lock_command->parsed()
+                                                         ? fmt::format("{}\n", p.error())
+                                                         : "",
+                                     .errors_to_stdout = errors_to_stdout};
+            }
+        }
+
+        if (lock_command->parsed()) {
+            std::vector<cps::search::Result> results;
+            results.reserve(found.size());
+            for (auto && p : found) {
+                results.emplace_back(std::move(p.value()));
+            }
+            if (auto && written = cps::lockfile::write(lock_output, session, queries, results); !written) {
+                return ProgramOutput{
+                    .retval = 1, .debug_output = written.error() + "\n", .errors_to_stdout = errors_to_stdout};
+            }
+            return ProgramOutput::Success();
+        }
+
+        cps::trace::Span print_span{"print"};
+        if (conf.mod_version && format == "pkgconf") {
+            // Like pkg-config, print the version of each package on its own line
+            for (auto && p : found) {
+                cps::printer::pkgconf(p.value(), conf);
+            }
+            return ProgramOutput::Success();
+        }
+
+        auto && result = found.front().value();
+        for (auto it = std::next(found.begin()); it != found.end(); ++it) {
+            result.merge(it->value());
+        }
+        result.deduplicate = !no_deduplicate;
+
+        if (hash) {
+            fmt::print("{}\n", result.digest());
+            return ProgramOutput::Success();
         }
-        auto && result = p.value();
 
         if (format == "pkgconf") {
             auto retval = cps::printer::pkgconf(result, conf);
             return ProgramOutput{.retval = retval};
         }
+        if (format == "json") {
+            auto retval = cps::printer::json(result);
+            return ProgramOutput{.retval = retval};
+        }
 
         return ProgramOutput{.retval = 1,
                              .debug_output = conf.print_errors ? fmt::format("Unknown mode {}\n", format) : "",
@@ -139,6 +506,9 @@ Support:
 
 int main(int argc, char * argv[]) {
     auto result = cps_config::run(argc, argv);
+    if (auto && traced = cps::trace::finish(); !traced) {
+        fmt::print(stderr, "{}\n", traced.error());
+    }
     if (!result.debug_output.empty()) {
         if (result.errors_to_stdout) {
             fmt::print(stdout, "{}", result.debug_output);
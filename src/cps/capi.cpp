@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/cps.h"
+
+#include "cps/config.hpp"
+#include "cps/env.hpp"
+#include "cps/search.hpp"
+
+#include <exception>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct cps_session {
+    cps_session(cps::Env env) : session{std::move(env)} {};
+
+    cps::search::Session session;
+    std::optional<std::string> error = std::nullopt;
+};
+
+struct cps_result {
+    cps_result(cps::search::Result && r);
+
+    cps::search::Result result;
+
+    // The result refers to the components it uses, so index their values for
+    // random access. Paths are resolved against their prefix, so are copied.
+    std::unordered_map<cps::loader::KnownLanguages, std::vector<const std::string *>> compile_flags;
+    std::unordered_map<cps::loader::KnownLanguages, std::vector<std::string>> includes;
+    std::unordered_map<cps::loader::KnownLanguages, std::vector<const cps::loader::Define *>> definitions;
+    std::vector<const cps::loader::LinkFlag *> link_flags;
+    std::vector<const std::string *> link_libraries;
+    std::vector<std::string> link_location;
+};
+
+namespace {
+
+    cps_string to_cps_string(std::string_view str) { return cps_string{str.data(), str.size()}; }
+
+    cps::loader::KnownLanguages to_language(cps_language lang) {
+        switch (lang) {
+        case CPS_LANGUAGE_CXX:
+            return cps::loader::KnownLanguages::cxx;
+        case CPS_LANGUAGE_FORTRAN:
+            return cps::loader::KnownLanguages::fortran;
+        case CPS_LANGUAGE_C:
+        default:
+            return cps::loader::KnownLanguages::c;
+        }
+    }
+
+    /// @brief Get the values for a language, without inserting it into the map
+    template <typename T>
+    const std::vector<T> * get_lang(const std::unordered_map<cps::loader::KnownLanguages, std::vector<T>> & map,
+                                    cps_language lang) {
+        if (auto && f = map.find(to_language(lang)); f != map.end()) {
+            return &f->second;
+        }
+        return nullptr;
+    }
+
+    template <typename T> size_t size_of(const std::vector<T> * vals) { return vals == nullptr ? 0 : vals->size(); }
+
+    template <typename T> const T * index_of(const std::vector<T> * vals, size_t index) {
+        if (vals == nullptr || index >= vals->size()) {
+            return nullptr;
+        }
+        return &(*vals)[index];
+    }
+
+    template <typename T> const T * index_of(const std::vector<const T *> * vals, size_t index) {
+        if (vals == nullptr || index >= vals->size()) {
+            return nullptr;
+        }
+        return (*vals)[index];
+    }
+
+    cps_string get_string(const std::string * str) {
+        return str == nullptr ? cps_string{nullptr, 0} : to_cps_string(*str);
+    }
+
+    /// @brief Resolve a path from a result, in the form used by the C API
+    std::string to_string(const cps::search::Result & r, const cps::loader::PrefixPath & p,
+                          const cps::search::Result::Entry & e) {
+#ifdef _WIN32
+        // Paths are wide strings on Windows
+        return p.resolve(r.prefix(e)).generic_string();
+#else
+        auto && [head, tail] = p.resolve_parts(r.prefix(e).native());
+        return std::string{head}.append(tail);
+#endif
+    }
+
+    std::optional<std::vector<cps::fs::path>> & get_paths(cps::Env & env, cps_path_kind kind) {
+        switch (kind) {
+        case CPS_PATH_CPS:
+            return env.cps_path;
+        case CPS_PATH_PREFIX:
+            return env.cps_prefix_path;
+        case CPS_PATH_PC:
+        default:
+            return env.pc_path;
+        }
+    }
+
+} // namespace
+
+cps_result::cps_result(cps::search::Result && r) : result{std::move(r)} {
+    using cps::loader::Component;
+    using Entry = cps::search::Result::Entry;
+
+    for (auto && lang :
+         {cps::loader::KnownLanguages::c, cps::loader::KnownLanguages::cxx, cps::loader::KnownLanguages::fortran}) {
+        result.for_each_compile(&Component::compile_flags, lang,
+                                [&](const std::string & f, auto &&) { compile_flags[lang].emplace_back(&f); });
+        result.for_each_compile(&Component::includes, lang, [&](const cps::loader::PrefixPath & p, const Entry & e) {
+            includes[lang].emplace_back(to_string(result, p, e));
+        });
+        result.for_each_compile(&Component::definitions, lang,
+                                [&](const cps::loader::Define & d, auto &&) { definitions[lang].emplace_back(&d); });
+    }
+    result.for_each_link(&Component::link_flags,
+                         [&](const cps::loader::LinkFlag & f, auto &&) { link_flags.emplace_back(&f); });
+    result.for_each_link(&Component::link_libraries,
+                         [&](const std::string & l, auto &&) { link_libraries.emplace_back(&l); });
+    result.for_each_location([&](const cps::loader::PrefixPath & l, const Entry & e) {
+        link_location.emplace_back(to_string(result, l, e));
+    });
+}
+
+extern "C" {
+
+const char * cps_version(void) { return CPS_CONFIG_VERSION; }
+
+cps_session * cps_session_new(void) {
+    try {
+        return new cps_session{cps::Env{}};
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+cps_session * cps_session_new_from_environment(void) {
+    try {
+        return new cps_session{cps::get_env()};
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+}
+
+void cps_session_free(cps_session * session) { delete session; }
+
+int cps_session_add_path(cps_session * session, cps_path_kind kind, const char * path) {
+    if (kind != CPS_PATH_CPS && kind != CPS_PATH_PREFIX && kind != CPS_PATH_PC) {
+        session->error = "Invalid path kind";
+        return 1;
+    }
+
+    try {
+        cps::Env env = session->session.env;
+        auto && paths = get_paths(env, kind);
+        if (!paths) {
+            paths.emplace();
+        }
+        paths->emplace_back(path);
+
+        // Anything already found may now be shadowed by the new path. The
+        // session is only replaced once the new one exists, so a failure
+        // leaves it as it was.
+        cps::search::Session replacement{std::move(env)};
+        session->session = std::move(replacement);
+    } catch (const std::exception & ex) {
+        session->error = ex.what();
+        return 1;
+    }
+    return 0;
+}
+
+const char * cps_session_error(const cps_session * session) {
+    return session->error ? session->error->c_str() : nullptr;
+}
+
+cps_result * cps_find_package(cps_session * session, const char * name, const char * const * components,
+                              size_t num_components, const char * prefix_variable) {
+    try {
+        std::vector<std::string> comps{components, components + (components == nullptr ? 0 : num_components)};
+        std::optional<std::string> prefix = std::nullopt;
+        if (prefix_variable != nullptr) {
+            prefix = prefix_variable;
+        }
+        auto && r = cps::search::find_package(session->session, name, comps, comps.empty(), prefix);
+        if (!r) {
+            session->error = std::move(r.error());
+            return nullptr;
+        }
+        return new cps_result{std::move(r.value())};
+    } catch (const std::exception & ex) {
+        session->error = ex.what();
+        return nullptr;
+    }
+}
+
+void cps_result_free(cps_result * result) { delete result; }
+
+cps_string cps_result_version(const cps_result * result) { return to_cps_string(result->result.version); }
+
+size_t cps_result_size(const cps_result * result, cps_field field, cps_language lang) {
+    const cps_result & r = *result;
+    switch (field) {
+    case CPS_FIELD_COMPILE_FLAGS:
+        return size_of(get_lang(r.compile_flags, lang));
+    case CPS_FIELD_INCLUDES:
+        return size_of(get_lang(r.includes, lang));
+    case CPS_FIELD_DEFINITIONS:
+        return size_of(get_lang(r.definitions, lang));
+    case CPS_FIELD_LINK_FLAGS:
+        return r.link_flags.size();
+    case CPS_FIELD_LINK_LIBRARIES:
+        return r.link_libraries.size();
+    case CPS_FIELD_LINK_LOCATION:
+        return r.link_location.size();
+    }
+    return 0;
+}
+
+cps_string cps_result_get(const cps_result * result, cps_field field, cps_language lang, size_t index) {
+    const cps_result & r = *result;
+    switch (field) {
+    case CPS_FIELD_COMPILE_FLAGS:
+        return get_string(index_of(get_lang(r.compile_flags, lang), index));
+    case CPS_FIELD_INCLUDES:
+        return get_string(index_of(get_lang(r.includes, lang), index));
+    case CPS_FIELD_DEFINITIONS:
+        if (auto && d = index_of(get_lang(r.definitions, lang), index)) {
+            return to_cps_string(d->get_name());
+        }
+        break;
+    case CPS_FIELD_LINK_FLAGS:
+        if (auto && f = index_of(&r.link_flags, index)) {
+            return to_cps_string(f->value);
+        }
+        break;
+    case CPS_FIELD_LINK_LIBRARIES:
+        return get_string(index_of(&r.link_libraries, index));
+    case CPS_FIELD_LINK_LOCATION:
+        return get_string(index_of(&r.link_location, index));
+    }
+    return cps_string{nullptr, 0};
+}
+
+int cps_result_definition_value(const cps_result * result, cps_language lang, size_t index, cps_string * value) {
+    if (auto && d = index_of(get_lang(result->definitions, lang), index)) {
+        if (auto && v = d->get_value()) {
+            *value = to_cps_string(v.value());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+cps_link_flag_type cps_result_link_flag_type(const cps_result * result, size_t index) {
+    if (auto && f = index_of(&result->link_flags, index)) {
+        switch (f->type) {
+        case cps::loader::LinkFlagType::search_dir:
+            return CPS_LINK_FLAG_SEARCH_DIR;
+        case cps::loader::LinkFlagType::library:
+            return CPS_LINK_FLAG_LIBRARY;
+        case cps::loader::LinkFlagType::framework:
+            return CPS_LINK_FLAG_FRAMEWORK;
+        case cps::loader::LinkFlagType::other:
+            break;
+        }
+    }
+    return CPS_LINK_FLAG_OTHER;
+}
+
+} // extern "C"
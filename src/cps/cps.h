@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: MIT */
+/* Copyright © 2025 Dylan Baker */
+
+/*
+ * A stable C interface to libcps, for querying packages in-process.
+ *
+ * All strings returned by this interface are owned by the object they were
+ * retrieved from, and remain valid until that object is freed.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+#if defined(CPS_BUILDING_LIBRARY)
+#define CPS_API __declspec(dllexport)
+#elif defined(CPS_STATIC)
+#define CPS_API
+#else
+#define CPS_API __declspec(dllimport)
+#endif
+#else
+#define CPS_API __attribute__((visibility("default")))
+#endif
+
+/** @brief State kept between queries, including loaded files */
+typedef struct cps_session cps_session;
+
+/** @brief The flags required to use a package */
+typedef struct cps_result cps_result;
+
+/** @brief A string that is not NUL terminated */
+typedef struct cps_string {
+    const char * data;
+    size_t size;
+} cps_string;
+
+typedef enum cps_path_kind {
+    /** @brief A directory containing CPS files, like `CPS_PATH` */
+    CPS_PATH_CPS,
+    /** @brief A prefix to search for CPS files in, like `CPS_PREFIX_PATH` */
+    CPS_PATH_PREFIX,
+    /** @brief A directory containing pc files, like `PKG_CONFIG_PATH` */
+    CPS_PATH_PC,
+} cps_path_kind;
+
+typedef enum cps_language {
+    CPS_LANGUAGE_C,
+    CPS_LANGUAGE_CXX,
+    CPS_LANGUAGE_FORTRAN,
+} cps_language;
+
+typedef enum cps_field {
+    /** @brief Per language compile flags */
+    CPS_FIELD_COMPILE_FLAGS,
+    /** @brief Per language include directories */
+    CPS_FIELD_INCLUDES,
+    /** @brief Per language definition names, see cps_result_definition_value for their values */
+    CPS_FIELD_DEFINITIONS,
+    /** @brief Link flags, see cps_result_link_flag_type for what kind each is */
+    CPS_FIELD_LINK_FLAGS,
+    /** @brief Libraries to link with */
+    CPS_FIELD_LINK_LIBRARIES,
+    /** @brief Paths to the binaries to link with */
+    CPS_FIELD_LINK_LOCATION,
+} cps_field;
+
+typedef enum cps_link_flag_type {
+    /** @brief A library search directory, the value is the directory */
+    CPS_LINK_FLAG_SEARCH_DIR,
+    /** @brief A library, the value is the name of the library */
+    CPS_LINK_FLAG_LIBRARY,
+    /** @brief A macOS framework, the value is the name of the framework */
+    CPS_LINK_FLAG_FRAMEWORK,
+    /** @brief Any other flag, the value is the full flag */
+    CPS_LINK_FLAG_OTHER,
+} cps_link_flag_type;
+
+/** @brief The version of libcps */
+CPS_API const char * cps_version(void);
+
+/**
+ * @brief Create a session with no search paths besides the system ones
+ * @return A new session, to be freed with cps_session_free, or NULL if it could not be created
+ */
+CPS_API cps_session * cps_session_new(void);
+
+/**
+ * @brief Create a session with search paths read from the environment, like cps-config
+ * @return A new session, to be freed with cps_session_free, or NULL if it could not be created
+ */
+CPS_API cps_session * cps_session_new_from_environment(void);
+
+CPS_API void cps_session_free(cps_session * session);
+
+/**
+ * @brief Add a path to be searched, after any already added paths of the same kind
+ * @return 0 on success, or non-zero on failure, see cps_session_error
+ */
+CPS_API int cps_session_add_path(cps_session * session, cps_path_kind kind, const char * path);
+
+/**
+ * @brief The error from the last failed call using this session
+ * @return A NUL terminated message, or NULL if nothing has failed
+ */
+CPS_API const char * cps_session_error(const cps_session * session);
+
+/**
+ * @brief Find a package, and calculate the flags required to use it
+ * @param name The name of the package, or a path to a CPS or pc file
+ * @param components The components required, or NULL to use the default components
+ * @param num_components The number of entries in components
+ * @param prefix_variable Overrides the value of `@prefix@`, or NULL to calculate it
+ *
+ * Repeated include directories, definitions, compile flags, libraries and
+ * library directories are only included once, and the system include and
+ * library directories are left out, as pkgconf does. These are the ones set
+ * when the library was built, or else those of /usr.
+ * @return A result to be freed with cps_result_free, or NULL on failure, see cps_session_error
+ */
+CPS_API cps_result * cps_find_package(cps_session * session, const char * name, const char * const * components,
+                                      size_t num_components, const char * prefix_variable);
+
+CPS_API void cps_result_free(cps_result * result);
+
+/** @brief The version of the package, or "unknown" */
+CPS_API cps_string cps_result_version(const cps_result * result);
+
+/**
+ * @brief The number of entries in a field
+ * @param lang The language, for per language fields, otherwise ignored
+ */
+CPS_API size_t cps_result_size(const cps_result * result, cps_field field, cps_language lang);
+
+/**
+ * @brief An entry in a field
+ * @param lang The language, for per language fields, otherwise ignored
+ * @return The entry, or a NULL string if index is out of range
+ */
+CPS_API cps_string cps_result_get(const cps_result * result, cps_field field, cps_language lang, size_t index);
+
+/**
+ * @brief The value of a definition
+ * @param value set to the value, if the definition has one
+ * @return non-zero if the definition has a value
+ */
+CPS_API int cps_result_definition_value(const cps_result * result, cps_language lang, size_t index,
+                                        cps_string * value);
+
+/** @brief What kind of link flag an entry of CPS_FIELD_LINK_FLAGS is */
+CPS_API cps_link_flag_type cps_result_link_flag_type(const cps_result * result, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/depfile.hpp"
+
+#include <fmt/format.h>
+
+#include <fstream>
+
+namespace cps::depfile {
+
+    std::string escape(std::string_view path) {
+        std::string out;
+        out.reserve(path.size());
+        for (const char c : path) {
+            switch (c) {
+            // A ':' would otherwise end the target, as in `C:\foo`
+            case ' ':
+            case '#':
+            case ':':
+                out += '\\';
+                break;
+            case '$':
+                out += '$';
+                break;
+            default:
+                break;
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    std::string rule(std::string_view target, const std::vector<fs::path> & inputs) {
+        std::string out = escape(target) + ':';
+        for (auto && input : inputs) {
+            out += " \\\n  ";
+            out += escape(input.string());
+        }
+        out += '\n';
+        return out;
+    }
+
+    tl::expected<void, std::string> write(const fs::path & path, std::string_view target,
+                                          const std::vector<fs::path> & inputs) {
+        std::ofstream out{path};
+        if (!out) {
+            return tl::unexpected(fmt::format("Could not open depfile {}", path.string()));
+        }
+        out << rule(target, inputs);
+        return {};
+    }
+
+} // namespace cps::depfile
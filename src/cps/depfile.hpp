@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#pragma once
+
+#include <tl/expected.hpp>
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Makefile rules listing the files a query used, for build systems to rerun it when they change
+namespace cps::depfile {
+
+    namespace fs = std::filesystem;
+
+    /// @brief Escape a path to be used as a target or prerequisite in a Makefile
+    std::string escape(std::string_view path);
+
+    /// @brief A Makefile rule making target depend on every input
+    std::string rule(std::string_view target, const std::vector<fs::path> & inputs);
+
+    /// @brief Write a rule to a file, replacing it
+    tl::expected<void, std::string> write(const fs::path & path, std::string_view target,
+                                          const std::vector<fs::path> & inputs);
+
+} // namespace cps::depfile
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/digest.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace cps::digest {
+
+    namespace {
+
+        // FIPS 180-4, section 4.2.2
+        constexpr std::array<uint32_t, 64> round_constants{
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        constexpr uint32_t rotr(uint32_t x, unsigned n) { return (x >> n) | (x << (32 - n)); }
+
+    } // namespace
+
+    // FIPS 180-4, section 5.3.3
+    Sha256::Sha256()
+        : state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19} {}
+
+    void Sha256::compress(const uint8_t * block) {
+        std::array<uint32_t, 64> w;
+        for (size_t i = 0; i < 16; ++i) {
+            w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16 |
+                   static_cast<uint32_t>(block[i * 4 + 2]) << 8 | static_cast<uint32_t>(block[i * 4 + 3]);
+        }
+        for (size_t i = 16; i < 64; ++i) {
+            const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        auto [a, b, c, d, e, f, g, h] = state;
+        for (size_t i = 0; i < 64; ++i) {
+            const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) +
+                                round_constants[i] + w[i];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    void Sha256::update(std::string_view data) {
+        length += data.size();
+        auto && bytes = reinterpret_cast<const uint8_t *>(data.data());
+        size_t remaining = data.size();
+
+        if (buffered > 0) {
+            const size_t n = std::min(remaining, buffer.size() - buffered);
+            std::copy_n(bytes, n, buffer.begin() + buffered);
+            buffered += n;
+            bytes += n;
+            remaining -= n;
+            if (buffered < buffer.size()) {
+                return;
+            }
+            compress(buffer.data());
+            buffered = 0;
+        }
+
+        for (; remaining >= buffer.size(); bytes += buffer.size(), remaining -= buffer.size()) {
+            compress(bytes);
+        }
+        std::copy_n(bytes, remaining, buffer.begin());
+        buffered = remaining;
+    }
+
+    void Sha256::field(std::string_view data) {
+        update(fmt::format("{}:", data.size()));
+        update(data);
+    }
+
+    std::string Sha256::hex() {
+        const uint64_t bits = length * 8;
+        // A single 1 bit, then zeros until there are 8 bytes left in the block for the length
+        const size_t padding = (buffered < 56 ? 56 : 120) - buffered;
+        std::array<char, 72> tail{};
+        tail[0] = static_cast<char>(0x80);
+        for (size_t i = 0; i < 8; ++i) {
+            tail[padding + i] = static_cast<char>(bits >> (56 - i * 8));
+        }
+        update({tail.data(), padding + 8});
+
+        std::string out;
+        out.reserve(64);
+        for (auto && word : state) {
+            fmt::format_to(std::back_inserter(out), "{:08x}", word);
+        }
+        return out;
+    }
+
+    std::string sha256(std::string_view data) {
+        Sha256 h{};
+        h.update(data);
+        return h.hex();
+    }
+
+} // namespace cps::digest
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/// @brief Digests of files and results, to tell when either has changed
+namespace cps::digest {
+
+    /// @brief A SHA-256 digest, computed incrementally
+    class Sha256 {
+      public:
+        Sha256();
+
+        /// @brief Add data to the digest
+        void update(std::string_view data);
+
+        /// @brief Add a field to the digest, prefixed by its length so that adjacent fields cannot run together
+        void field(std::string_view data);
+
+        /// @brief Finish the digest, and return it as lowercase hex
+        ///
+        /// Nothing may be added afterwards.
+        std::string hex();
+
+      private:
+        void compress(const uint8_t * block);
+
+        std::array<uint32_t, 8> state;
+        std::array<uint8_t, 64> buffer{};
+        size_t buffered = 0;
+        uint64_t length = 0;
+    };
+
+    /// @brief The SHA-256 of some data, as lowercase hex
+    std::string sha256(std::string_view data);
+
+} // namespace cps::digest
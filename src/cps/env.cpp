@@ -11,38 +11,34 @@
 
 namespace cps {
 
-    namespace {
-        std::vector<fs::path> get_paths(const char * input) {
-            const char * path_sep =
-#ifdef _WIN32
-                ";"
-#else
-                ":"
-#endif
-                ;
-            std::vector<std::string> path_strs = utils::split(input, path_sep);
-            auto result = std::vector<fs::path>{};
-            std::transform(path_strs.begin(), path_strs.end(), std::back_inserter(result),
-                           [](const std::string & s) { return fs::path{s}; });
-            return result;
-        }
-    } // namespace
-
     Env get_env() {
         auto env = Env{};
         if (const char * env_c = std::getenv("CPS_PATH")) {
-            env.cps_path = get_paths(env_c);
+            env.cps_path = utils::split_paths(env_c);
         }
         if (const char * env_c = std::getenv("CPS_PREFIX_PATH")) {
             // TODO: Windows
-            env.cps_prefix_path = get_paths(env_c);
+            env.cps_prefix_path = utils::split_paths(env_c);
         }
         if (const char * env_c = std::getenv("PKG_CONFIG_PATH")) {
-            env.pc_path = get_paths(env_c);
+            env.pc_path = utils::split_paths(env_c);
         }
         if (std::getenv("PKG_CONFIG_DEBUG_SPEW") || std::getenv("CPS_CONFIG_DEBUG_SPEW")) {
             env.debug_spew = true;
         }
+        if (const char * env_c = std::getenv("CPS_CONFIG_TRACE"); env_c != nullptr && *env_c != '\0') {
+            env.trace_file = fs::path{env_c};
+        }
+
+        // Named as pkgconf names them
+        if (const char * env_c = std::getenv("PKG_CONFIG_SYSTEM_INCLUDE_PATH")) {
+            env.system_include_path = utils::split_paths(env_c);
+        }
+        if (const char * env_c = std::getenv("PKG_CONFIG_SYSTEM_LIBRARY_PATH")) {
+            env.system_library_path = utils::split_paths(env_c);
+        }
+        env.keep_system_cflags = std::getenv("PKG_CONFIG_ALLOW_SYSTEM_CFLAGS") != nullptr;
+        env.keep_system_libs = std::getenv("PKG_CONFIG_ALLOW_SYSTEM_LIBS") != nullptr;
         return env;
     }
 
@@ -18,6 +18,22 @@ namespace cps {
         std::optional<std::vector<fs::path>> cps_prefix_path = std::nullopt;
         std::optional<std::vector<fs::path>> pc_path = std::nullopt;
         bool debug_spew = false;
+        /// @brief Where to write a trace of the query, if anywhere
+        std::optional<fs::path> trace_file = std::nullopt;
+        /// @brief Include directories the compiler searches anyway, which are left out of the output
+        ///
+        /// If unset, the directories set when cps-config was built are used, or else the include directory of /usr
+        std::optional<std::vector<fs::path>> system_include_path = std::nullopt;
+        /// @brief Library directories the linker searches anyway, which are left out of the output
+        ///
+        /// If unset, the directories set when cps-config was built are used, or else the library directories of /usr
+        std::optional<std::vector<fs::path>> system_library_path = std::nullopt;
+        /// @brief Print system include directories anyway
+        bool keep_system_cflags = false;
+        /// @brief Print system library directories anyway
+        bool keep_system_libs = false;
+        /// @brief Hash each file loaded, which Result::digest() and lockfiles need
+        bool digests = false;
     };
 
     Env get_env();
@@ -12,22 +12,28 @@
 
 #include <filesystem>
 #include <iostream>
+#include <iterator>
 #include <optional>
+#include <string_view>
 
 namespace cps::loader {
 
+    /// @brief Objects keep their members in the order they are written, so
+    /// everything is used in the order the CPS file declares it
+    using Json = nlohmann::ordered_json;
+
     namespace {
 
         namespace fs = std::filesystem;
 
         template <typename T>
         tl::expected<std::optional<T>, std::string>
-        get_optional(const nlohmann::json & parent, std::string_view parent_name, const std::string & name) {
+        get_optional(const Json & parent, std::string_view parent_name, const std::string & name) {
             // It's okay for a member to be missing from an optional value
             if (!parent.contains(name)) {
                 return std::nullopt;
             }
-            const nlohmann::json & value = parent[name];
+            const Json & value = parent[name];
 
             if constexpr (std::is_same_v<T, std::string>) {
                 if (value.is_string()) {
@@ -50,14 +56,22 @@ namespace cps::loader {
 
         template <>
         tl::expected<std::optional<fs::path>, std::string>
-        get_optional(const nlohmann::json & parent, std::string_view parent_name, const std::string & name) {
+        get_optional(const Json & parent, std::string_view parent_name, const std::string & name) {
             return get_optional<std::string>(parent, parent_name, name).map([](const std::optional<std::string> & v) {
                 return v ? std::optional{fs::path{v.value()}} : std::nullopt;
             });
         };
 
+        template <>
+        tl::expected<std::optional<PrefixPath>, std::string>
+        get_optional(const Json & parent, std::string_view parent_name, const std::string & name) {
+            return get_optional<std::string>(parent, parent_name, name).map([](const std::optional<std::string> & v) {
+                return v ? std::optional{PrefixPath{v.value()}} : std::nullopt;
+            });
+        };
+
         template <typename T>
-        tl::expected<T, std::string> get_required(const nlohmann::json & parent, std::string_view parent_name,
+        tl::expected<T, std::string> get_required(const Json & parent, std::string_view parent_name,
                                                   const std::string & name) {
             if (!parent.contains(name)) {
                 return tl::unexpected(fmt::format("Required field `{}` in `{}` is missing!", name, parent_name));
@@ -114,7 +128,7 @@ namespace cps::loader {
         }
 
         template <>
-        tl::expected<LangStrings, std::string> get_required<LangStrings>(const nlohmann::json & parent,
+        tl::expected<LangStrings, std::string> get_required<LangStrings>(const Json & parent,
                                                                          std::string_view parent_name,
                                                                          const std::string & name) {
             LangStrings ret{};
@@ -122,7 +136,7 @@ namespace cps::loader {
                 return ret;
             }
 
-            const nlohmann::json & value = parent[name];
+            const Json & value = parent[name];
             if (value.is_object()) {
                 auto && fallback = CPS_TRY(get_optional<std::vector<std::string>>(value, name, "*"))
                                        .value_or(std::vector<std::string>{});
@@ -148,16 +162,17 @@ namespace cps::loader {
         }
 
         template <>
-        tl::expected<LangPaths, std::string>
-        get_required<LangPaths>(const nlohmann::json & parent, std::string_view parent_name, const std::string & name) {
+        tl::expected<LangPrefixPaths, std::string> get_required<LangPrefixPaths>(const Json & parent,
+                                                                                 std::string_view parent_name,
+                                                                                 const std::string & name) {
             const auto expected_lang_strings = get_required<LangStrings>(parent, parent_name, name);
             const auto result = expected_lang_strings.map([](const LangStrings & lang_strings) {
-                LangPaths lang_paths;
+                LangPrefixPaths lang_paths;
                 std::transform(lang_strings.begin(), lang_strings.end(), std::inserter(lang_paths, lang_paths.end()),
                                [](const auto & pair) {
-                                   std::vector<fs::path> paths;
+                                   std::vector<PrefixPath> paths;
                                    std::transform(pair.second.begin(), pair.second.end(), std::back_inserter(paths),
-                                                  [](const std::string & s) { return fs::path{s}; });
+                                                  [](const std::string & s) { return PrefixPath{s}; });
                                    return std::make_pair(pair.first, paths);
                                });
                 return lang_paths;
@@ -167,13 +182,13 @@ namespace cps::loader {
 
         template <>
         tl::expected<Defines, std::string>
-        get_required<Defines>(const nlohmann::json & parent, std::string_view parent_name, const std::string & name) {
+        get_required<Defines>(const Json & parent, std::string_view parent_name, const std::string & name) {
             Defines ret;
             if (!parent.contains(name)) {
                 return ret;
             }
 
-            const nlohmann::json & defines = parent[name];
+            const Json & defines = parent[name];
             if (!defines.is_object()) {
                 return tl::unexpected(fmt::format("Section `{}` of `{}` is not an object", parent_name, name));
             }
@@ -211,13 +226,13 @@ namespace cps::loader {
 
         template <>
         tl::expected<Requires, std::string>
-        get_required<Requires>(const nlohmann::json & parent, std::string_view parent_name, const std::string & name) {
+        get_required<Requires>(const Json & parent, std::string_view parent_name, const std::string & name) {
             Requires ret{};
             if (!parent.contains(name)) {
                 return ret;
             }
 
-            nlohmann::json require = parent[name];
+            Json require = parent[name];
             if (!require.is_object()) {
                 return tl::unexpected(fmt::format("`{}` field of `{}` is not an object", name, parent_name));
             }
@@ -225,13 +240,13 @@ namespace cps::loader {
             for (const auto & item : require.items()) {
                 // TODO: error handling for not a string?
                 const std::string key = item.key();
-                const nlohmann::json & obj = item.value();
+                const Json & obj = item.value();
 
-                ret.emplace(key, Requirement{
-                                     CPS_TRY(get_optional<std::vector<std::string>>(obj, name, "components"))
-                                         .value_or(std::vector<std::string>{}),
-                                     CPS_TRY(get_optional<std::string>(obj, name, "version")),
-                                 });
+                ret.emplace_back(key, Requirement{
+                                          CPS_TRY(get_optional<std::vector<std::string>>(obj, name, "components"))
+                                              .value_or(std::vector<std::string>{}),
+                                          CPS_TRY(get_optional<std::string>(obj, name, "version")),
+                                      });
             }
 
             return ret;
@@ -240,7 +255,7 @@ namespace cps::loader {
         using Components = std::unordered_map<std::string, Component>;
 
         template <>
-        tl::expected<Components, std::string> get_required<Components>(const nlohmann::json & parent,
+        tl::expected<Components, std::string> get_required<Components>(const Json & parent,
                                                                        std::string_view parent_name,
                                                                        const std::string & name) {
             if (!parent.contains(name)) {
@@ -250,7 +265,7 @@ namespace cps::loader {
             std::unordered_map<std::string, Component> components{};
 
             // TODO: error handling for not an object
-            nlohmann::json compmap = parent[name];
+            Json compmap = parent[name];
             if (!compmap.is_object()) {
                 return tl::unexpected(fmt::format("`{}` field of `{}` is not an object", name, parent_name));
             }
@@ -258,7 +273,7 @@ namespace cps::loader {
             for (const auto & item : compmap.items()) {
                 // TODO: Error handling for not a string?
                 const std::string key = item.key();
-                const nlohmann::json & comp = item.value();
+                const Json & comp = item.value();
 
                 if (!comp.is_object()) {
                     return tl::unexpected(fmt::format("`{}` `{}` is not an object", name, key));
@@ -266,15 +281,16 @@ namespace cps::loader {
 
                 auto const type = CPS_TRY(get_required<std::string>(comp, name, "type").map(string_to_type));
                 auto const compile_flags = CPS_TRY(get_required<LangStrings>(comp, name, "compile_flags"));
-                auto const includes = CPS_TRY(get_required<LangPaths>(comp, name, "includes"));
+                auto const includes = CPS_TRY(get_required<LangPrefixPaths>(comp, name, "includes"));
                 auto const definitions = CPS_TRY(get_required<Defines>(comp, name, "definitions"));
-                auto const link_flags = CPS_TRY(get_optional<std::vector<std::string>>(comp, name, "link_flags"))
-                                            .value_or(std::vector<std::string>{});
+                auto const link_flags = parse_link_flags(
+                    CPS_TRY(get_optional<std::vector<std::string>>(comp, name, "link_flags"))
+                        .value_or(std::vector<std::string>{}));
                 auto const link_libraries =
                     CPS_TRY(get_optional<std::vector<std::string>>(comp, name, "link_libraries"))
                         .value_or(std::vector<std::string>{});
-                auto const location = CPS_TRY(get_optional<std::string>(comp, name, "location"));
-                auto const link_location = CPS_TRY(get_optional<std::string>(comp, name, "link_location"));
+                auto const location = CPS_TRY(get_optional<PrefixPath>(comp, name, "location"));
+                auto const link_location = CPS_TRY(get_optional<PrefixPath>(comp, name, "link_location"));
                 auto const link_requires = CPS_TRY(get_optional<std::vector<std::string>>(comp, name, "link_requires"))
                                                .value_or(std::vector<std::string>{});
                 auto const require = CPS_TRY(get_optional<std::vector<std::string>>(comp, name, "requires"))
@@ -332,8 +348,126 @@ namespace cps::loader {
     Define::Define(std::string name_) : name{std::move(name_)}, value{std::nullopt} {};
     Define::Define(std::string name_, std::string value_) : name{std::move(name_)}, value{std::move(value_)} {};
 
-    std::string Define::get_name() const { return name; }
-    std::optional<std::string> Define::get_value() const { return value; }
+    const std::string & Define::get_name() const { return name; }
+    const std::optional<std::string> & Define::get_value() const { return value; }
+
+    bool Define::operator==(const Define & other) const { return name == other.name && value == other.value; }
+
+    namespace {
+        constexpr std::string_view prefix_marker = "@prefix@";
+
+        bool is_separator(char c) { return c == '/' || c == fs::path::preferred_separator; }
+    } // namespace
+
+    PrefixPath::PrefixPath(std::string_view path_)
+        : prefixed{path_.substr(0, prefix_marker.size()) == prefix_marker &&
+                   (path_.size() == prefix_marker.size() || is_separator(path_[prefix_marker.size()]))} {
+        if (prefixed) {
+            path_.remove_prefix(prefix_marker.size());
+            while (!path_.empty() && is_separator(path_.front())) {
+                path_.remove_prefix(1);
+            }
+            if (!path_.empty()) {
+                path = "/";
+            }
+        }
+        path += path_;
+    }
+
+    bool PrefixPath::relative_to_prefix() const { return prefixed; }
+
+    fs::path PrefixPath::resolve(const fs::path & prefix) const {
+        if (!prefixed) {
+            return path;
+        }
+        const std::string p = prefix.string();
+        auto && [head, tail] = resolve_parts(p);
+        std::string out;
+        out.reserve(head.size() + tail.size());
+        out.append(head).append(tail);
+        return out;
+    }
+
+    std::pair<std::string_view, std::string_view> PrefixPath::resolve_parts(std::string_view prefix) const {
+        const std::string_view tail = path;
+        if (!prefixed) {
+            return {{}, tail};
+        }
+        if (tail.empty()) {
+            return {prefix, tail};
+        }
+        // Like joining the paths, an empty prefix leaves the path relative
+        if (prefix.empty()) {
+            return {prefix, tail.substr(1)};
+        }
+        // Nor does joining double the separator
+        while (!prefix.empty() && is_separator(prefix.back())) {
+            prefix.remove_suffix(1);
+        }
+        return {prefix, tail};
+    }
+
+    bool PrefixPath::operator==(const PrefixPath & other) const {
+        return prefixed == other.prefixed && path == other.path;
+    }
+
+    std::string_view to_string(KnownLanguages lang) {
+        switch (lang) {
+        case KnownLanguages::c:
+            return "c";
+        case KnownLanguages::cxx:
+            return "c++";
+        case KnownLanguages::fortran:
+            return "fortran";
+        }
+        abort();
+    }
+
+    std::optional<KnownLanguages> string_to_language(std::string_view str) {
+        if (str == "c") {
+            return KnownLanguages::c;
+        }
+        if (str == "c++" || str == "cxx") {
+            return KnownLanguages::cxx;
+        }
+        if (str == "fortran") {
+            return KnownLanguages::fortran;
+        }
+        return std::nullopt;
+    }
+
+    std::vector<LinkFlag> parse_link_flags(const std::vector<std::string> & flags) {
+        std::vector<LinkFlag> ret;
+        ret.reserve(flags.size());
+
+        for (auto it = flags.begin(); it != flags.end(); ++it) {
+            const std::string_view flag = *it;
+
+            // Handles both the joined (`-lfoo`) and separate (`-l foo`) forms
+            const auto && add_with_arg = [&](LinkFlagType type, std::string_view prefix) {
+                if (flag.size() > prefix.size()) {
+                    ret.emplace_back(LinkFlag{type, std::string{flag.substr(prefix.size())}});
+                } else if (std::next(it) != flags.end()) {
+                    ++it;
+                    ret.emplace_back(LinkFlag{type, *it});
+                } else {
+                    ret.emplace_back(LinkFlag{LinkFlagType::other, *it});
+                }
+            };
+
+            if (flag.substr(0, 2) == "-L") {
+                add_with_arg(LinkFlagType::search_dir, "-L");
+            } else if (flag.substr(0, 2) == "-l") {
+                add_with_arg(LinkFlagType::library, "-l");
+            } else if (flag == "-framework") {
+                add_with_arg(LinkFlagType::framework, "-framework");
+            } else {
+                ret.emplace_back(LinkFlag{LinkFlagType::other, *it});
+            }
+        }
+
+        return ret;
+    }
 
     Configuration::Configuration() = default;
     Configuration::Configuration(LangStrings cflags) : compile_flags{std::move(cflags)} {};
@@ -346,10 +480,10 @@ namespace cps::loader {
     Platform::Platform() = default;
 
     tl::expected<Package, std::string> load(std::istream & input_buffer, const std::filesystem::path & filename) {
-        nlohmann::json root;
+        Json root;
         try {
-            root = nlohmann::json::parse(input_buffer);
-        } catch (const nlohmann::json::exception & ex) {
+            root = Json::parse(input_buffer);
+        } catch (const Json::exception & ex) {
             return tl::make_unexpected(
                 fmt::format("Exception caught while parsing json for `{}.cps`\n{}", filename.string(), ex.what()));
         }
@@ -397,6 +531,7 @@ namespace cps::loader {
             .require = std::move(require), // requires is a keyword
             .version = std::move(version),
             .version_schema = std::move(version_schema),
+            .digest = "", // The stream may not be a whole file, so this is left to the caller
         };
     }
 } // namespace cps::loader
@@ -14,6 +14,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace cps::loader {
@@ -27,6 +28,12 @@ namespace cps::loader {
         fortran,
     };
 
+    /// @brief Get the CPS name of a language
+    std::string_view to_string(KnownLanguages lang);
+
+    /// @brief Get a language from its CPS name
+    std::optional<KnownLanguages> string_to_language(std::string_view str);
+
     /// @brief  Linker required
     enum class LinkLanguage {
         c,
@@ -50,32 +57,88 @@ namespace cps::loader {
         Define(std::string name);
         Define(std::string name, std::string value);
 
-        std::string get_name() const;
-        std::optional<std::string> get_value() const;
+        const std::string & get_name() const;
+        const std::optional<std::string> & get_value() const;
+
+        bool operator==(const Define & other) const;
 
       private:
         std::string name;
         std::optional<std::string> value;
     };
 
+    /// @brief What kind of link flag this is
+    enum class LinkFlagType {
+        /// @brief A library search directory (`-L<dir>`)
+        search_dir,
+        /// @brief A library to link with (`-l<name>`)
+        library,
+        /// @brief A macOS framework to link with (`-framework <name>`)
+        framework,
+        /// @brief Any other flag, passed through as is
+        other,
+    };
+
+    /// @brief A link flag that has been categorized and split from its prefix
+    struct LinkFlag {
+        LinkFlagType type;
+        /// @brief The flag's argument, without the `-L`, `-l`, or `-framework`. For `other` this is the full flag
+        std::string value;
+    };
+
+    /// @brief Categorize raw link flags
+    /// @param flags A list of link flags, one argument per entry
+    /// @return The categorized flags, in the same order
+    std::vector<LinkFlag> parse_link_flags(const std::vector<std::string> & flags);
+
     using LangStrings = std::unordered_map<KnownLanguages, std::vector<std::string>>;
     using LangPaths = std::unordered_map<KnownLanguages, std::vector<fs::path>>;
 
+    /// @brief A path from a package, which may be relative to the package's prefix
+    ///
+    /// Whether the path starts with `@prefix@` is decided once, when the
+    /// package is loaded, so that applying a prefix is a single concatenation.
+    class PrefixPath {
+      public:
+        explicit PrefixPath(std::string_view path);
+
+        /// @brief Whether the path starts with `@prefix@`
+        bool relative_to_prefix() const;
+
+        /// @brief Replace `@prefix@` with a prefix, if the path starts with it
+        /// @return The path, which is unchanged if it does not start with `@prefix@`
+        fs::path resolve(const fs::path & prefix) const;
+
+        /// @brief Like resolve(), but without building the path
+        /// @return Two strings, which are the resolved path when concatenated, and refer to prefix or this
+        std::pair<std::string_view, std::string_view> resolve_parts(std::string_view prefix) const;
+
+        bool operator==(const PrefixPath & other) const;
+
+      private:
+        /// @brief The path, without `@prefix@` if it is relative to the prefix, in which case it is empty or
+        /// starts with a single `/`
+        std::string path;
+        bool prefixed;
+    };
+
+    using LangPrefixPaths = std::unordered_map<KnownLanguages, std::vector<PrefixPath>>;
+
     using Defines = std::unordered_map<KnownLanguages, std::vector<Define>>;
 
     struct Component {
         Type type;
         LangStrings compile_flags;
-        LangPaths includes;
+        LangPrefixPaths includes;
         Defines definitions;
         // TODO: configurations
         // TODO: std::vector<std::string> link_features;
-        std::vector<std::string> link_flags;
+        std::vector<LinkFlag> link_flags;
         // TODO: std::vector<LinkLanguage> link_languages;
         std::vector<std::string> link_libraries;
         std::vector<std::string> link_requires;
-        std::optional<std::string> location;
-        std::optional<std::string> link_location;
+        std::optional<PrefixPath> location;
+        std::optional<PrefixPath> link_location;
         std::vector<std::string> require; // requires is a keyword
     };
 
@@ -108,7 +171,8 @@ namespace cps::loader {
         std::optional<std::string> version;
     };
 
-    using Requires = std::unordered_map<std::string, Requirement>;
+    /// @brief Required packages, by name, in the order they are declared
+    using Requires = std::vector<std::pair<std::string, Requirement>>;
 
     class Platform {
       public:
@@ -142,6 +206,9 @@ namespace cps::loader {
         Requires require; // Requires is a keyword
         std::optional<std::string> version;
         version::Schema version_schema;
+        /// @brief The SHA-256 of the file the package was loaded from, if it was loaded by a search which asked
+        /// for digests
+        std::string digest;
     };
 
     constexpr inline std::string_view CPS_VERSION = "0.13.0";
@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/lockfile.hpp"
+
+#include "cps/digest.hpp"
+#include "cps/loader.hpp"
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cps::lockfile {
+
+    namespace {
+
+        using Json = nlohmann::ordered_json;
+
+        /// @brief Bumped whenever the format changes, older lockfiles are not read
+        constexpr int lockfile_version = 2;
+
+        constexpr std::array<loader::KnownLanguages, 3> all_languages{
+            loader::KnownLanguages::c, loader::KnownLanguages::cxx, loader::KnownLanguages::fortran};
+
+        /// @brief The SHA-256 of a file, read the same way search reads it
+        std::optional<std::string> fingerprint(const fs::path & path) {
+            std::ifstream file{path};
+            if (!file) {
+                return std::nullopt;
+            }
+            const std::string contents{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+            return digest::sha256(contents);
+        }
+
+        /// @brief The values of each entry of a result, as they are visited
+        ///
+        /// Repeated values are kept, so that whether they are removed can
+        /// still be chosen when the lockfile is used. System directories
+        /// have already been removed. Each entry also records what
+        /// Result::digest() covers, so that a locked result has the same
+        /// digest as the result it was written from.
+        Json entries_to_json(search::Result r) {
+            r.deduplicate = false;
+            std::vector<Json> entries;
+            entries.reserve(r.entries.size());
+            for (auto && e : r.entries) {
+                auto && components = e.package->components;
+                auto && name = std::find_if(components.begin(), components.end(),
+                                            [&e](auto && c) { return &c.second == e.component; });
+                entries.emplace_back(Json{
+                    {"package", e.package->name},
+                    {"component", name == components.end() ? "" : name->first},
+                    {"filename", e.package->filename},
+                    {"digest", e.package->digest},
+                    {"prefix", r.prefix(e).generic_string()},
+                    {"link_only", e.link_only},
+                });
+            }
+            auto && entry = [&](const search::Result::Entry & e) -> Json & {
+                return entries[static_cast<size_t>(&e - r.entries.data())];
+            };
+
+            for (auto && lang : all_languages) {
+                const std::string name{loader::to_string(lang)};
+                r.for_each_compile(&loader::Component::compile_flags, lang,
+                                   [&](const std::string & f, auto && e) { entry(e)["compile_flags"][name].push_back(f); });
+            }
+            for (auto && lang : all_languages) {
+                const std::string name{loader::to_string(lang)};
+                r.for_each_compile(&loader::Component::includes, lang,
+                                   [&](const loader::PrefixPath & p, const search::Result::Entry & e) {
+                                       entry(e)["includes"][name].push_back(p.resolve(r.prefix(e)).generic_string());
+                                   });
+            }
+            for (auto && lang : all_languages) {
+                const std::string name{loader::to_string(lang)};
+                r.for_each_compile(&loader::Component::definitions, lang, [&](const loader::Define & d, auto && e) {
+                    auto && v = d.get_value();
+                    entry(e)["definitions"][name].push_back(v ? fmt::format("{}={}", d.get_name(), v.value())
+                                                              : d.get_name());
+                });
+            }
+
+            // Written as arguments, and parsed again when read
+            r.for_each_link(&loader::Component::link_flags, [&](const loader::LinkFlag & f, auto && e) {
+                Json & flags = entry(e)["link_flags"];
+                switch (f.type) {
+                case loader::LinkFlagType::search_dir:
+                    flags.push_back("-L" + f.value);
+                    break;
+                case loader::LinkFlagType::library:
+                    flags.push_back("-l" + f.value);
+                    break;
+                case loader::LinkFlagType::framework:
+                    flags.push_back("-framework");
+                    flags.push_back(f.value);
+                    break;
+                case loader::LinkFlagType::other:
+                    flags.push_back(f.value);
+                    break;
+                }
+            });
+            r.for_each_link(&loader::Component::link_libraries,
+                            [&](const std::string & l, auto && e) { entry(e)["link_libraries"].push_back(l); });
+            r.for_each_location([&](const loader::PrefixPath & l, const search::Result::Entry & e) {
+                entry(e)["location"] = l.resolve(r.prefix(e)).generic_string();
+            });
+
+            return entries;
+        }
+
+        template <typename T, typename F>
+        std::unordered_map<loader::KnownLanguages, std::vector<T>> lang_values_from_json(const Json & entry,
+                                                                                          const char * key, F && make) {
+            std::unordered_map<loader::KnownLanguages, std::vector<T>> out;
+            if (auto && values = entry.find(key); values != entry.end()) {
+                for (auto && [lang, list] : values->items()) {
+                    auto && known = loader::string_to_language(lang);
+                    if (!known) {
+                        throw std::invalid_argument{fmt::format("unknown language {}", lang)};
+                    }
+                    auto && dest = out[known.value()];
+                    for (auto && v : list) {
+                        dest.emplace_back(make(v.template get<std::string>()));
+                    }
+                }
+            }
+            return out;
+        }
+
+        /// @brief System directories, sorted so that the lockfile is stable, or null if they are kept
+        Json dirs_to_json(const search::SystemDirs & dirs) {
+            if (dirs == nullptr) {
+                return nullptr;
+            }
+            std::vector<std::string> sorted{dirs->begin(), dirs->end()};
+            std::sort(sorted.begin(), sorted.end());
+            return sorted;
+        }
+
+        search::SystemDirs dirs_from_json(const Json & dirs) {
+            if (dirs.is_null()) {
+                return nullptr;
+            }
+            auto && list = dirs.get<std::vector<std::string>>();
+            return std::make_shared<const std::unordered_set<std::string>>(list.begin(), list.end());
+        }
+
+        bool same_dirs(const search::SystemDirs & l, const search::SystemDirs & r) {
+            return l == nullptr || r == nullptr ? l == r : *l == *r;
+        }
+
+        std::vector<std::string> strings_from_json(const Json & entry, const char * key) {
+            if (auto && values = entry.find(key); values != entry.end()) {
+                return values->get<std::vector<std::string>>();
+            }
+            return {};
+        }
+
+        /// @brief Rebuild a result from the entries written by entries_to_json
+        ///
+        /// Entries from the same file share a package, and keep the names of
+        /// their components. The paths are already resolved, so the prefixes
+        /// are only kept for Result::digest().
+        search::Result result_from_json(const Json & query) {
+            search::Result result{};
+            result.version = query.at("version").get<std::string>();
+
+            std::unordered_map<std::string, std::shared_ptr<loader::Package>> packages;
+            std::unordered_map<std::string, size_t> prefixes;
+            for (auto && e : query.at("entries")) {
+                auto && filename = e.at("filename").get<std::string>();
+                auto && package = packages[filename];
+                if (package == nullptr) {
+                    package = std::make_shared<loader::Package>();
+                    package->name = e.at("package").get<std::string>();
+                    package->filename = filename;
+                    package->digest = e.at("digest").get<std::string>();
+                }
+
+                loader::Component c{};
+                c.type = loader::Type::unknown;
+                c.compile_flags =
+                    lang_values_from_json<std::string>(e, "compile_flags", [](std::string s) { return s; });
+                c.includes = lang_values_from_json<loader::PrefixPath>(
+                    e, "includes", [](const std::string & s) { return loader::PrefixPath{s}; });
+                c.definitions = lang_values_from_json<loader::Define>(e, "definitions", [](const std::string & s) {
+                    if (auto && eq = s.find('='); eq != std::string::npos) {
+                        return loader::Define{s.substr(0, eq), s.substr(eq + 1)};
+                    }
+                    return loader::Define{s};
+                });
+                c.link_flags = loader::parse_link_flags(strings_from_json(e, "link_flags"));
+                c.link_libraries = strings_from_json(e, "link_libraries");
+                if (auto && l = e.find("location"); l != e.end()) {
+                    c.location = loader::PrefixPath{l->get<std::string>()};
+                }
+                // A component which is used twice has the same values both times
+                auto && component = package->components.emplace(e.at("component").get<std::string>(), std::move(c));
+
+                auto && prefix = e.at("prefix").get<std::string>();
+                auto && [index, added] = prefixes.emplace(prefix, result.prefixes.size());
+                if (added) {
+                    result.prefixes.emplace_back(prefix);
+                }
+
+                result.entries.emplace_back(search::Result::Entry{.package = package,
+                                                                  .component = &component.first->second,
+                                                                  .prefix = index->second,
+                                                                  .link_only = e.at("link_only").get<bool>()});
+            }
+            return result;
+        }
+
+    } // namespace
+
+    tl::expected<void, std::string> write(const fs::path & path, const search::Session & session,
+                                          const std::vector<search::Query> & queries,
+                                          const std::vector<search::Result> & results) {
+        if (!session.env.digests) {
+            return tl::unexpected("Lockfiles can only be written by a session which computes digests");
+        }
+
+        Json files = Json::object();
+        for (auto && input : session.inputs()) {
+            // Directories are left out, the lockfile does not change when files are added
+            if (!fs::is_regular_file(input)) {
+                continue;
+            }
+            auto && fp = fingerprint(input);
+            if (!fp) {
+                return tl::unexpected(fmt::format("Could not read {}", input.string()));
+            }
+            files[input.generic_string()] = fp.value();
+        }
+
+        Json locked = Json::array();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            auto && q = queries[i];
+            locked.push_back({
+                {"package", q.name},
+                {"components", q.components},
+                {"default_components", q.default_components},
+                {"prefix_variable", q.prefix_variable ? Json(q.prefix_variable.value()) : Json(nullptr)},
+                {"version", results[i].version},
+                {"entries", entries_to_json(results[i])},
+            });
+        }
+
+        const Json root{
+            {"lockfile_version", lockfile_version},
+            {"system_includes", dirs_to_json(session.system_includes())},
+            {"system_libdirs", dirs_to_json(session.system_libdirs())},
+            {"files", std::move(files)},
+            {"queries", std::move(locked)},
+        };
+
+        std::ofstream out{path};
+        if (!out) {
+            return tl::unexpected(fmt::format("Could not open lockfile {}", path.string()));
+        }
+        out << root.dump(2) << '\n';
+        return {};
+    }
+
+    tl::expected<Lockfile, std::string> read(const fs::path & path) {
+        std::ifstream file{path};
+        if (!file) {
+            return tl::unexpected(fmt::format("Could not open lockfile {}", path.string()));
+        }
+
+        Lockfile lock{};
+        try {
+            const Json root = Json::parse(file);
+            if (root.at("lockfile_version").get<int>() != lockfile_version) {
+                return tl::unexpected(fmt::format("Lockfile {} was written by a different version of cps-config",
+                                                  path.string()));
+            }
+
+            for (auto && [name, expected] : root.at("files").items()) {
+                if (fingerprint(name) != expected.get<std::string>()) {
+                    return tl::unexpected(
+                        fmt::format("{} has changed since lockfile {} was written", name, path.string()));
+                }
+                lock.files.emplace_back(name);
+            }
+
+            lock.system_includes = dirs_from_json(root.at("system_includes"));
+            lock.system_libdirs = dirs_from_json(root.at("system_libdirs"));
+            for (auto && q : root.at("queries")) {
+                auto && prefix_variable = q.at("prefix_variable");
+                search::Query query{
+                    .name = q.at("package").get<std::string>(),
+                    .components = q.at("components").get<std::vector<std::string>>(),
+                    .default_components = q.at("default_components").get<bool>(),
+                    .prefix_variable = prefix_variable.is_null()
+                                           ? std::nullopt
+                                           : std::optional<std::string>{prefix_variable.get<std::string>()},
+                };
+                auto && result = result_from_json(q);
+                // The values have already been left out, these are only for Result::digest()
+                result.system_includes = lock.system_includes;
+                result.system_libdirs = lock.system_libdirs;
+                lock.results.emplace_back(std::move(query), std::move(result));
+            }
+        } catch (const std::exception & ex) {
+            return tl::unexpected(fmt::format("Lockfile {} is not valid: {}", path.string(), ex.what()));
+        }
+        return lock;
+    }
+
+    tl::expected<search::Result, std::string> find(const Lockfile & lock, const search::Query & query,
+                                                   const search::Session & session) {
+        if (!same_dirs(lock.system_includes, session.system_includes()) ||
+            !same_dirs(lock.system_libdirs, session.system_libdirs())) {
+            return tl::unexpected("it was written with different system directories");
+        }
+        for (auto && [q, result] : lock.results) {
+            if (q.name == query.name && q.components == query.components &&
+                q.default_components == query.default_components && q.prefix_variable == query.prefix_variable) {
+                return result;
+            }
+        }
+        if (query.components.empty()) {
+            return tl::unexpected(fmt::format("{} is not locked", query.name));
+        }
+        return tl::unexpected(fmt::format("{} with components {} is not locked", query.name,
+                                          fmt::join(query.components, ", ")));
+    }
+
+} // namespace cps::lockfile
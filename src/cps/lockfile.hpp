@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#pragma once
+
+#include "cps/search.hpp"
+
+#include <tl/expected.hpp>
+
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// @brief Results of queries saved to a file, so they can be answered without searching
+///
+/// A lockfile holds the result of each query it was written for, with
+/// every path already resolved, and a fingerprint of each file loaded while
+/// answering them. It is only used if none of those files have changed.
+/// Files added to the search paths since it was written are not noticed,
+/// the lockfile pins what was found when it was written.
+namespace cps::lockfile {
+
+    namespace fs = std::filesystem;
+
+    /// @brief A lockfile which has been read, and whose files are unchanged
+    struct Lockfile {
+        /// @brief The files the results were loaded from
+        std::vector<fs::path> files;
+        /// @brief The system directories left out of the results, which must match the session's to use them
+        search::SystemDirs system_includes;
+        search::SystemDirs system_libdirs;
+        std::vector<std::pair<search::Query, search::Result>> results;
+    };
+
+    /// @brief Write the results of queries, and the fingerprints of the files their session loaded
+    /// @param session The session the results were found with, which must have been asked for digests
+    /// @param results The result of each query, in the same order
+    tl::expected<void, std::string> write(const fs::path & path, const search::Session & session,
+                                          const std::vector<search::Query> & queries,
+                                          const std::vector<search::Result> & results);
+
+    /// @brief Read a lockfile
+    /// @return The lockfile, or an error if it cannot be read or any of its files have changed
+    tl::expected<Lockfile, std::string> read(const fs::path & path);
+
+    /// @brief The locked result of a query
+    /// @return The result, or why it cannot be used: the query was not locked, or the session would leave out
+    /// different system directories
+    tl::expected<search::Result, std::string> find(const Lockfile & lock, const search::Query & query,
+                                                   const search::Session & session);
+
+} // namespace cps::lockfile
@@ -11,9 +11,11 @@
 #include <algorithm>
 #include <filesystem>
 #include <iterator>
+#include <mutex>
 #include <optional>
 #include <ostream>
 #include <stdexcept>
+#include <string_view>
 #include <variant>
 
 #include <fmt/format.h>
@@ -23,6 +25,64 @@ namespace cps::pc_compat {
 
     namespace fs = std::filesystem;
 
+    namespace {
+
+        /// @brief The generated scanner keeps its state in globals, so only one file may be scanned at a time
+        std::mutex scanner_lock;
+
+        struct SplitCflags {
+            std::vector<std::string> flags;
+            std::vector<loader::PrefixPath> includes;
+            std::vector<loader::Define> definitions;
+        };
+
+        /// @brief Sort the arguments of a Cflags field into includes, definitions, and other flags
+        ///
+        /// Includes and definitions are printed after the other flags, but
+        /// keep their order among themselves, which is the order the
+        /// compiler uses them in. Where that is not enough they are left
+        /// with the other flags, in the order of the file: definitions if
+        /// any macro is undefined, since `-DFOO -UFOO` would become
+        /// `-UFOO -DFOO`, and includes if `-I-` splits them.
+        SplitCflags split_cflags(std::string_view input) {
+            SplitCflags ret;
+            const std::vector<std::string> args = utils::split_whitespace(input);
+            const bool keep_definitions = std::none_of(args.begin(), args.end(), [](std::string_view a) {
+                return a.substr(0, 2) == "-U" || a == "-undef";
+            });
+            const bool keep_includes = std::find(args.begin(), args.end(), "-I-") == args.end();
+
+            for (auto it = args.begin(); it != args.end(); ++it) {
+                std::string_view arg = *it;
+                const std::string_view kind = arg.substr(0, 2);
+                if (!(kind == "-I" && keep_includes) && !(kind == "-D" && keep_definitions)) {
+                    ret.flags.emplace_back(arg);
+                    continue;
+                }
+
+                // Handles both the joined (`-Ifoo`) and separate (`-I foo`) forms
+                arg.remove_prefix(2);
+                if (arg.empty()) {
+                    if (std::next(it) == args.end()) {
+                        ret.flags.emplace_back(*it);
+                        continue;
+                    }
+                    arg = *++it;
+                }
+
+                if (kind == "-I") {
+                    ret.includes.emplace_back(arg);
+                } else if (const auto eq = arg.find('='); eq != std::string_view::npos) {
+                    ret.definitions.emplace_back(std::string{arg.substr(0, eq)}, std::string{arg.substr(eq + 1)});
+                } else {
+                    ret.definitions.emplace_back(std::string{arg});
+                }
+            }
+            return ret;
+        }
+
+    } // namespace
+
     std::ostream & operator<<(std::ostream & ost, const std::optional<VersionOperation> & version_operation) {
         if (!version_operation) {
             return ost;
@@ -81,28 +141,36 @@ namespace cps::pc_compat {
     PcLoader::PcLoader() = default;
 
     tl::expected<loader::Package, std::string> PcLoader::load(std::istream & istream, fs::path const & filename) {
-        scan_begin(istream);
-        yy::parser parse(*this);
-        // To debug parser, uncomment the following line
-        // TODO: add a way to enable debug output without rebuilding
-        // parse.set_debug_level(true);
-        if (const int result = parse(); result != 0) {
-            throw std::runtime_error("Failed to parse the given pkg-config file.");
+        {
+            const std::lock_guard<std::mutex> guard{scanner_lock};
+            scan_begin(istream);
+            yy::parser parse(*this);
+            // To debug parser, uncomment the following line
+            // TODO: add a way to enable debug output without rebuilding
+            // parse.set_debug_level(true);
+            if (const int result = parse(); result != 0) {
+                throw std::runtime_error("Failed to parse the given pkg-config file.");
+            }
         }
 
         std::string name = CPS_TRY(get_property("Name").and_then(get_string));
 
         loader::LangStrings compile_flags;
+        loader::LangPrefixPaths includes;
+        loader::Defines definitions;
         if (auto compile_flags_input = get_property("Cflags").and_then(get_string)) {
-            auto compile_flags_vec = utils::split(*compile_flags_input);
-            compile_flags.emplace(loader::KnownLanguages::c, compile_flags_vec);
-            compile_flags.emplace(loader::KnownLanguages::cxx, compile_flags_vec);
-            compile_flags.emplace(loader::KnownLanguages::fortran, compile_flags_vec);
+            auto && [flags_vec, includes_vec, defines_vec] = split_cflags(*compile_flags_input);
+            for (auto && lang :
+                 {loader::KnownLanguages::c, loader::KnownLanguages::cxx, loader::KnownLanguages::fortran}) {
+                compile_flags.emplace(lang, flags_vec);
+                includes.emplace(lang, includes_vec);
+                definitions.emplace(lang, defines_vec);
+            }
         }
 
-        std::vector<std::string> link_flags;
+        std::vector<loader::LinkFlag> link_flags;
         if (auto link_flags_input = get_property("Libs").and_then(get_string)) {
-            link_flags = cps::utils::split(*link_flags_input);
+            link_flags = loader::parse_link_flags(utils::split_whitespace(*link_flags_input));
         }
 
         std::vector<std::string> require;
@@ -115,14 +183,14 @@ namespace cps::pc_compat {
         components.emplace(
             name, loader::Component{.type = loader::Type::unknown,
                                     .compile_flags = compile_flags,
-                                    .includes = loader::LangPaths{},
-                                    .definitions = loader::Defines{},
+                                    .includes = includes,
+                                    .definitions = definitions,
                                     .link_flags = link_flags,
                                     .link_libraries = {},
                                     .link_requires = {},
                                     // TODO: Currently lib location is hard coded to appease assertions. This would
                                     // need to implement linker-like search to replicate current behavior.
-                                    .location = fmt::format("@prefix@/lib/{}.a", name),
+                                    .location = loader::PrefixPath{fmt::format("@prefix@/lib/{}.a", name)},
                                     .link_location = std::nullopt,
                                     .require = require});
 
@@ -140,7 +208,9 @@ namespace cps::pc_compat {
                                .platform = std::nullopt,
                                .require = {}, // TODO: Parse requires
                                .version = version,
-                               .version_schema = version::Schema::custom};
+                               // pkg-config compares versions with rpmvercmp
+                               .version_schema = version::Schema::rpm,
+                               .digest = ""};
     }
 
     tl::expected<PcPropertyValue, std::string> PcLoader::get_property(const std::string & property_name) const {
@@ -7,88 +7,297 @@
 #include <algorithm>
 #include <filesystem>
 #include <fmt/format.h>
-#include <fmt/ranges.h>
+#include <iterator>
+#include <nlohmann/json.hpp>
+#include <string_view>
 #include <tl/expected.hpp>
 
 namespace cps::printer {
 
     namespace fs = std::filesystem;
 
-    int pkgconf(const search::Result & r, const Config & conf) {
-        std::vector<std::string> args{};
+    namespace {
 
-        if (conf.mod_version) {
-            fmt::print("{}\n", r.version);
-            return 0;
+        using Buffer = fmt::memory_buffer;
+
+        /// @brief Append a single argument, with a separating space if the buffer is not empty
+        void append_arg(Buffer & buf, std::string_view prefix, std::string_view value) {
+            if (buf.size() != 0) {
+                buf.push_back(' ');
+            }
+            buf.append(prefix);
+            buf.append(value);
         }
 
-        if (conf.cflags) {
-            if (auto && f = r.compile_flags.find(loader::KnownLanguages::c);
-                f != r.compile_flags.end() && !f->second.empty()) {
-                // XXX: assumes compile flags
-                // XXX: assumes C
-                args.reserve(args.size() + f->second.size());
-                args.insert(args.end(), f->second.begin(), f->second.end());
+        /// @brief Append a path from a package, resolved against the package's prefix
+        void append_path(Buffer & buf, std::string_view arg, const loader::PrefixPath & p,
+                         const fs::path & package_prefix) {
+#ifdef _WIN32
+            append_arg(buf, arg, p.resolve(package_prefix).generic_string());
+#else
+            // Already in generic form, so concatenate the native strings directly into the buffer
+            auto && [head, tail] = p.resolve_parts(package_prefix.native());
+            append_arg(buf, arg, head);
+            buf.append(tail);
+#endif
+        }
+
+        /// @brief Append a buffer built with `append_arg` to the end of another one
+        void append_args(Buffer & buf, const Buffer & args) {
+            if (args.size() == 0) {
+                return;
+            }
+            if (buf.size() != 0) {
+                buf.push_back(' ');
             }
+            buf.append(args);
         }
 
-        if (conf.includes) {
-            if (auto && f = r.includes.find(loader::KnownLanguages::c); f != r.includes.end() && !f->second.empty()) {
-                std::transform(f->second.begin(), f->second.end(), std::back_inserter(args),
-                               [](const fs::path & p) { return fmt::format("-I{}", p.generic_string()); });
+        template <typename T>
+        const std::vector<T> * get_lang(const std::unordered_map<loader::KnownLanguages, std::vector<T>> & map,
+                                        loader::KnownLanguages lang) {
+            if (auto && f = map.find(lang); f != map.end() && !f->second.empty()) {
+                return &f->second;
             }
+            return nullptr;
         }
 
-        if (conf.defines) {
-            if (auto && f = r.definitions.find(loader::KnownLanguages::c);
-                f != r.definitions.end() && !f->second.empty()) {
-                auto && transformer = [](auto && d) {
+        template <typename T>
+        bool same_values(const std::unordered_map<loader::KnownLanguages, std::vector<T>> & map,
+                         loader::KnownLanguages left, loader::KnownLanguages right) {
+            const std::vector<T> * l = get_lang(map, left);
+            const std::vector<T> * r = get_lang(map, right);
+            return l == r || (l != nullptr && r != nullptr && *l == *r);
+        }
+
+        /// @brief Would the compile flags for both languages be the same
+        bool same_compile_args(const search::Result & r, loader::KnownLanguages left, loader::KnownLanguages right) {
+            return std::all_of(r.entries.begin(), r.entries.end(), [&](const search::Result::Entry & e) {
+                auto && c = *e.component;
+                return e.link_only || (same_values(c.compile_flags, left, right) &&
+                                       same_values(c.includes, left, right) && same_values(c.definitions, left, right));
+            });
+        }
+
+        void render_compile_args(Buffer & buf, const search::Result & r, const Config & conf,
+                                 loader::KnownLanguages lang) {
+            if (conf.cflags) {
+                // XXX: assumes compile flags
+                r.for_each_compile(&loader::Component::compile_flags, lang,
+                                   [&buf](const std::string & flag, auto &&) { append_arg(buf, "", flag); });
+            }
+
+            if (conf.includes) {
+                r.for_each_compile(&loader::Component::includes, lang,
+                                   [&buf, &r](const loader::PrefixPath & p, const search::Result::Entry & e) {
+                                       append_path(buf, "-I", p, r.prefix(e));
+                                   });
+            }
+
+            if (conf.defines) {
+                r.for_each_compile(&loader::Component::definitions, lang, [&buf](const loader::Define & d, auto &&) {
+                    append_arg(buf, "-D", d.get_name());
                     if (auto && v = d.get_value()) {
-                        return fmt::format("-D{}={}", d.get_name(), v.value());
-                    } else {
-                        return fmt::format("-D{}", d.get_name());
+                        buf.push_back('=');
+                        buf.append(std::string_view{v.value()});
                     }
-                };
-                args.reserve(args.size() + f->second.size());
-                std::transform(f->second.begin(), f->second.end(), std::back_inserter(args), transformer);
+                });
             }
         }
 
-        if (conf.libs_search) {
-            for (auto && f : r.link_flags) {
-                if (f.substr(0, 2) == "-L") {
-                    args.emplace_back(f);
+        void render_link_args(Buffer & buf, const search::Result & r, const Config & conf) {
+            if (!(conf.libs_search || conf.libs_other || conf.libs_link)) {
+                return;
+            }
+
+            // Walk the link flags once, putting -L flags directly into the
+            // output (they come next), and holding onto the others until their
+            // place in the output is reached.
+            Buffer other;
+            Buffer link;
+            r.for_each_link(&loader::Component::link_flags, [&](const loader::LinkFlag & f, auto &&) {
+                switch (f.type) {
+                case loader::LinkFlagType::search_dir:
+                    if (conf.libs_search) {
+                        append_arg(buf, "-L", f.value);
+                    }
+                    break;
+                case loader::LinkFlagType::library:
+                    if (conf.libs_link) {
+                        append_arg(link, "-l", f.value);
+                    }
+                    break;
+                case loader::LinkFlagType::framework:
+                    if (conf.libs_other) {
+                        append_arg(other, "-framework ", f.value);
+                    }
+                    break;
+                case loader::LinkFlagType::other:
+                    if (conf.libs_other) {
+                        append_arg(other, "", f.value);
+                    }
+                    break;
                 }
+            });
+
+            append_args(buf, other);
+
+            if (conf.libs_link) {
+                r.for_each_location([&buf, &r](const loader::PrefixPath & l, const search::Result::Entry & e) {
+                    append_path(buf, "-l", l, r.prefix(e));
+                });
+                r.for_each_link(&loader::Component::link_libraries,
+                                [&buf](const std::string & l, auto &&) { append_arg(buf, "-l", l); });
+                append_args(buf, link);
             }
         }
 
-        if (conf.libs_other) {
-            for (auto && f : r.link_flags) {
-                if (auto && x = f.substr(0, 2); x != "-l" && x != "-L") {
-                    args.emplace_back(f);
-                }
+        std::string to_json_string(const search::Result &, const std::string & s, const search::Result::Entry &) {
+            return s;
+        }
+
+        std::string to_json_string(const search::Result & r, const loader::PrefixPath & p,
+                                   const search::Result::Entry & e) {
+            return p.resolve(r.prefix(e)).generic_string();
+        }
+
+        std::string to_json_string(const search::Result &, const loader::Define & d, const search::Result::Entry &) {
+            if (auto && v = d.get_value()) {
+                return fmt::format("{}={}", d.get_name(), v.value());
+            }
+            return d.get_name();
+        }
+
+        template <typename T>
+        nlohmann::json to_json_array(const search::Result & r, const std::vector<T> loader::Component::*field) {
+            nlohmann::json arr = nlohmann::json::array();
+            r.for_each_link(field, [&](const T & v, const search::Result::Entry & e) {
+                arr.emplace_back(to_json_string(r, v, e));
+            });
+            return arr;
+        }
+
+        template <typename T>
+        nlohmann::json
+        to_json_array(const search::Result & r,
+                      const std::unordered_map<loader::KnownLanguages, std::vector<T>> loader::Component::*field,
+                      loader::KnownLanguages lang) {
+            nlohmann::json arr = nlohmann::json::array();
+            r.for_each_compile(field, lang, [&](const T & v, const search::Result::Entry & e) {
+                arr.emplace_back(to_json_string(r, v, e));
+            });
+            return arr;
+        }
+
+    } // namespace
+
+    int pkgconf(const search::Result & r, const Config & conf, std::FILE * out) {
+        if (conf.mod_version) {
+            fmt::print(out, "{}\n", r.version);
+            return 0;
+        }
+
+        // Everything is rendered into a single buffer, and written with a single call.
+        Buffer buf;
+
+        if (conf.languages.size() <= 1) {
+            // The common case, render directly into the output
+            if (!conf.languages.empty()) {
+                render_compile_args(buf, r, conf, conf.languages.front());
             }
+            render_link_args(buf, r, conf);
+            buf.push_back('\n');
+            std::fwrite(buf.data(), 1, buf.size(), out);
+            return 0;
         }
 
-        if (conf.libs_link) {
-            if (auto && f = r.link_location; !f.empty()) {
-                args.reserve(args.size() + f.size());
-                std::transform(f.begin(), f.end(), std::back_inserter(args),
-                               [](const fs::path & p) { return fmt::format("-l{}", p.generic_string()); });
+        // The link arguments are the same for every language
+        Buffer link;
+        render_link_args(link, r, conf);
+
+        // Languages very often have identical compile arguments (such as when
+        // they are set with `*`), so only render each unique set once
+        std::vector<Buffer> compile;
+        std::vector<size_t> compile_index(conf.languages.size());
+        size_t total = 0;
+        for (size_t i = 0; i < conf.languages.size(); ++i) {
+            compile_index[i] = compile.size();
+            for (size_t j = 0; j < i; ++j) {
+                if (same_compile_args(r, conf.languages[i], conf.languages[j])) {
+                    compile_index[i] = compile_index[j];
+                    break;
+                }
             }
-            if (auto && f = r.link_libraries; !f.empty()) {
-                args.reserve(args.size() + f.size());
-                std::transform(f.begin(), f.end(), std::back_inserter(args),
-                               [](std::string_view s) { return fmt::format("-l{}", s); });
+            if (compile_index[i] == compile.size()) {
+                render_compile_args(compile.emplace_back(), r, conf, conf.languages[i]);
             }
-            for (auto && f : r.link_flags) {
-                if (f.substr(0, 2) == "-l") {
-                    args.emplace_back(f);
+            // The name, a colon, a separator before each section, and the newline
+            total += loader::to_string(conf.languages[i]).size() + 4 + compile[compile_index[i]].size() + link.size();
+        }
+        buf.reserve(total);
+
+        // Each language gets its own line, prefixed with the language name
+        for (size_t i = 0; i < conf.languages.size(); ++i) {
+            buf.append(loader::to_string(conf.languages[i]));
+            buf.push_back(':');
+            for (const Buffer * section : {&compile[compile_index[i]], &link}) {
+                if (section->size() != 0) {
+                    buf.push_back(' ');
+                    buf.append(*section);
                 }
             }
+            buf.push_back('\n');
+        }
+
+        std::fwrite(buf.data(), 1, buf.size(), out);
+        return 0;
+    }
+
+    int json(const search::Result & r, std::FILE * out) {
+        nlohmann::json languages = nlohmann::json::object();
+        for (auto && lang : {loader::KnownLanguages::c, loader::KnownLanguages::cxx, loader::KnownLanguages::fortran}) {
+            languages[std::string{loader::to_string(lang)}] = {
+                {"compile_flags", to_json_array(r, &loader::Component::compile_flags, lang)},
+                {"includes", to_json_array(r, &loader::Component::includes, lang)},
+                {"definitions", to_json_array(r, &loader::Component::definitions, lang)},
+            };
         }
 
-        fmt::print("{}\n", fmt::join(args, " "));
+        // Link flags are rendered back into arguments, so that they can be
+        // passed directly to a compiler
+        nlohmann::json link_flags = nlohmann::json::array();
+        r.for_each_link(&loader::Component::link_flags, [&link_flags](const loader::LinkFlag & f, auto &&) {
+            switch (f.type) {
+            case loader::LinkFlagType::search_dir:
+                link_flags.emplace_back("-L" + f.value);
+                break;
+            case loader::LinkFlagType::library:
+                link_flags.emplace_back("-l" + f.value);
+                break;
+            case loader::LinkFlagType::framework:
+                link_flags.emplace_back("-framework");
+                link_flags.emplace_back(f.value);
+                break;
+            case loader::LinkFlagType::other:
+                link_flags.emplace_back(f.value);
+                break;
+            }
+        });
+
+        nlohmann::json link_location = nlohmann::json::array();
+        r.for_each_location([&](const loader::PrefixPath & l, const search::Result::Entry & e) {
+            link_location.emplace_back(to_json_string(r, l, e));
+        });
+
+        const nlohmann::json root{
+            {"version", r.version},
+            {"languages", std::move(languages)},
+            {"link_flags", std::move(link_flags)},
+            {"link_libraries", to_json_array(r, &loader::Component::link_libraries)},
+            {"link_location", std::move(link_location)},
+        };
+
+        fmt::print(out, "{}\n", root.dump());
         return 0;
     }
 
@@ -6,6 +6,9 @@
 
 #include "cps/search.hpp"
 
+#include <cstdio>
+#include <vector>
+
 namespace cps::printer {
 
     struct Config {
@@ -17,8 +20,18 @@ namespace cps::printer {
         bool libs_other = false;
         bool mod_version = false;
         bool print_errors = false;
+        /// @brief The languages to print compile flags for. If more than one
+        /// language is requested each is printed on its own line, prefixed
+        /// with the name of the language.
+        std::vector<loader::KnownLanguages> languages{loader::KnownLanguages::c};
     };
 
-    int pkgconf(const search::Result & dag, const Config & conf);
+    /// @brief Print the result in pkg-config style
+    /// @param out the stream to write to, the output is written with a single call
+    int pkgconf(const search::Result & dag, const Config & conf, std::FILE * out = stdout);
+
+    /// @brief Print the entire result, for all languages, as a single line of JSON
+    /// @param out the stream to write to
+    int json(const search::Result & dag, std::FILE * out = stdout);
 
 } // namespace cps::printer
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/scheduler.hpp"
+
+#include <algorithm>
+
+namespace cps::scheduler {
+
+    namespace {
+
+        /// @brief The pool, and the index of the worker in it, of the calling thread
+        struct Worker {
+            Pool * pool = nullptr;
+            size_t index = 0;
+        };
+
+        thread_local Worker this_worker{};
+
+    } // namespace
+
+    size_t default_threads() { return std::max<size_t>(std::thread::hardware_concurrency(), 1); }
+
+    Pool::Pool(size_t count) {
+        count = std::max<size_t>(count, 1);
+        queues.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            queues.emplace_back(std::make_unique<Queue>());
+        }
+        threads.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            threads.emplace_back([this, i]() { work(i); });
+        }
+    }
+
+    Pool::~Pool() {
+        wait();
+        {
+            const std::lock_guard<std::mutex> guard{sleep_lock};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto && t : threads) {
+            t.join();
+        }
+    }
+
+    Pool * Pool::current() { return this_worker.pool; }
+
+    void Pool::submit(std::function<void()> task) {
+        const size_t index =
+            this_worker.pool == this ? this_worker.index : next.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+        pending.fetch_add(1);
+        {
+            // Counted under the queue's lock, so no worker can take the task
+            // before it is counted, and the count never underflows. Idle
+            // workers never see a count without a task behind it.
+            const std::lock_guard<std::mutex> guard{queues[index]->lock};
+            queues[index]->tasks.emplace_back(std::move(task));
+            queued.fetch_add(1);
+        }
+        {
+            // Taking the lock ensures that a worker cannot miss the wakeup
+            // between checking for work and going to sleep
+            const std::lock_guard<std::mutex> guard{sleep_lock};
+            wake.notify_one();
+        }
+    }
+
+    void Pool::wait() {
+        std::unique_lock<std::mutex> guard{sleep_lock};
+        finished.wait(guard, [this]() { return pending.load() == 0; });
+    }
+
+    bool Pool::pop(size_t index, std::function<void()> & task) {
+        // Newest first from our own queue
+        {
+            Queue & own = *queues[index];
+            const std::lock_guard<std::mutex> guard{own.lock};
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        // Otherwise the oldest from someone else's
+        for (size_t i = 1; i < queues.size(); ++i) {
+            Queue & victim = *queues[(index + i) % queues.size()];
+            const std::lock_guard<std::mutex> guard{victim.lock};
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Pool::work(size_t index) {
+        this_worker = Worker{this, index};
+
+        std::function<void()> task;
+        while (true) {
+            if (pop(index, task)) {
+                queued.fetch_sub(1);
+                task();
+                task = nullptr;
+                if (pending.fetch_sub(1) == 1) {
+                    const std::lock_guard<std::mutex> guard{sleep_lock};
+                    finished.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard{sleep_lock};
+            wake.wait(guard, [this]() { return stopping || queued.load() != 0; });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+} // namespace cps::scheduler
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cps::scheduler {
+
+    /// @brief The number of threads to use when none is requested
+    size_t default_threads();
+
+    /// @brief A fixed set of worker threads, each with its own queue of tasks
+    ///
+    /// Tasks submitted from a worker go onto that worker's queue, which it
+    /// runs newest first, so that a task's subtasks run while their data is
+    /// still hot. Idle workers steal the oldest task from another worker's
+    /// queue, which tends to be the largest remaining piece of work.
+    class Pool {
+      public:
+        explicit Pool(size_t threads = default_threads());
+        ~Pool();
+
+        Pool(const Pool &) = delete;
+        Pool & operator=(const Pool &) = delete;
+
+        /// @brief Queue a task, which must not throw. It may be called from inside another task
+        void submit(std::function<void()> task);
+
+        /// @brief Wait until every task submitted, including those submitted by other tasks, has finished
+        ///
+        /// This must not be called from inside a task.
+        void wait();
+
+        /// @brief The pool the calling thread is a worker of, or nullptr
+        static Pool * current();
+
+      private:
+        struct Queue {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void work(size_t index);
+        bool pop(size_t index, std::function<void()> & task);
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> threads;
+
+        /// @brief Tasks that are queued, but not yet taken by a worker
+        std::atomic<size_t> queued{0};
+        /// @brief Tasks that have been submitted, but have not finished
+        std::atomic<size_t> pending{0};
+        /// @brief Which queue the next task submitted from outside the pool goes onto
+        std::atomic<size_t> next{0};
+
+        std::mutex sleep_lock;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        bool stopping = false;
+    };
+
+} // namespace cps::scheduler
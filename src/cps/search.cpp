@@ -4,10 +4,14 @@
 
 #include "cps/search.hpp"
 
+#include "cps/config.hpp"
+#include "cps/digest.hpp"
 #include "cps/error.hpp"
 #include "cps/loader.hpp"
 #include "cps/pc_compat/pc_loader.hpp"
 #include "cps/platform.hpp"
+#include "cps/scheduler.hpp"
+#include "cps/trace.hpp"
 #include "cps/utils.hpp"
 #include "cps/version.hpp"
 
@@ -16,11 +20,19 @@
 #include <tl/expected.hpp>
 
 #include <algorithm>
+#include <cstdlib>
 #include <deque>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -42,30 +54,49 @@ namespace cps::search {
         /// load
         class Dependency {
           public:
-            Dependency(loader::Package && obj) : package{std::move(obj)} {};
-
-            /// @brief The loaded CPS file
-            loader::Package package;
-            /// @brief the components from that CPS file to use
-            std::unordered_map<std::string, ComponentDetails> components;
+            Dependency(std::shared_ptr<const loader::Package> obj) : package{std::move(obj)} {};
+
+            /// @brief The loaded CPS file, which may be shared with other queries
+            std::shared_ptr<const loader::Package> package;
+            /// @brief the components from that CPS file to use, in the order they were first required
+            ///
+            /// This is the order their arguments are used in, so it must not
+            /// depend on anything but the CPS files.
+            std::vector<std::pair<std::string, ComponentDetails>> components;
+
+            /// @brief Find a component to use by name
+            ComponentDetails * find(std::string_view name) {
+                auto && it = std::find_if(components.begin(), components.end(),
+                                          [name](auto && c) { return c.first == name; });
+                return it == components.end() ? nullptr : &it->second;
+            }
         };
 
         /// @brief A DAG node
         class Node {
           public:
             Node(Dependency obj) : data{std::move(obj)} {};
-            Node(loader::Package obj) : data{std::move(obj)} {};
+            Node(std::shared_ptr<const loader::Package> obj) : data{std::move(obj)} {};
 
             Dependency data;
+            /// @brief The nodes of every package this one requires, once they have been built
+            std::vector<std::shared_ptr<Node>> required;
+            /// @brief The nodes of the packages whose components are used, in the order they are used
             std::vector<std::shared_ptr<Node>> depends;
+            /// @brief Whether required has been built, nodes are shared by every package requiring them
+            bool resolved = false;
+            /// @brief Whether set_components() has been called on this node
+            bool visited = false;
         };
 
         void dfs(const std::shared_ptr<Node> & node, std::unordered_set<std::shared_ptr<Node>> & visited,
                  std::deque<std::shared_ptr<Node>> & sorted) {
             visited.emplace(node);
-            for (auto && d : node->depends) {
-                if (visited.find(d) == visited.end()) {
-                    dfs(d, visited, sorted);
+            // Each dependency is put in front of those visited before it, so
+            // visit them backwards to keep them in the order they are declared
+            for (auto it = node->depends.rbegin(); it != node->depends.rend(); ++it) {
+                if (visited.find(*it) == visited.end()) {
+                    dfs(*it, visited, sorted);
                 }
             }
             sorted.emplace_front(node);
@@ -88,6 +119,40 @@ namespace cps::search {
         // TODO: const std::vector<std::string> mac_prefix{""};
         // TODO: const std::vector<std::string> win_prefix{""};
 
+        /// @brief How a directory is compared with the system directories, in generic form without a trailing separator
+        std::string system_dir_key(const fs::path & dir) {
+            std::string key = dir.generic_string();
+            while (key.size() > 1 && key.back() == '/') {
+                key.pop_back();
+            }
+            return key;
+        }
+
+        /// @brief The directories left out of results
+        /// @param dirs The directories set in the environment, if any
+        /// @param configured The directories set when cps-config was built, used if dirs is not set
+        /// @param subdirs The directories under the system prefix to use, if neither is set
+        SystemDirs system_dirs(const std::optional<std::vector<fs::path>> & dirs, std::string_view configured,
+                               const std::vector<fs::path> & subdirs) {
+            auto set = std::make_shared<std::unordered_set<std::string>>();
+            if (dirs) {
+                for (auto && d : dirs.value()) {
+                    set->emplace(system_dir_key(d));
+                }
+            } else if (!configured.empty()) {
+                for (auto && d : utils::split_paths(configured)) {
+                    set->emplace(system_dir_key(d));
+                }
+            } else {
+                // Like pkgconf, only /usr, the directories of /usr/local are
+                // searched first and so are not redundant
+                for (auto && d : subdirs) {
+                    set->emplace(system_dir_key(nix_prefix.front() / d));
+                }
+            }
+            return set;
+        }
+
         enum class SearchPathType { cps, pc };
 
         struct SearchPath {
@@ -95,8 +160,6 @@ namespace cps::search {
             SearchPathType type;
         };
 
-        std::vector<SearchPath> cached_paths{};
-
         /// @brief expands a single search prefix into a set of full paths
         /// @param prefix the prefix to build from
         /// @return A vector of paths to search, in order
@@ -113,8 +176,9 @@ namespace cps::search {
             return paths;
         };
 
-        void add_to_search_path(const std::vector<fs::path> & paths, SearchPathType type) {
-            std::transform(paths.begin(), paths.end(), std::back_inserter(cached_paths),
+        void add_to_search_path(std::vector<SearchPath> & search_paths, const std::vector<fs::path> & paths,
+                                SearchPathType type) {
+            std::transform(paths.begin(), paths.end(), std::back_inserter(search_paths),
                            [&type](const auto & path) { return SearchPath{.path = path, .type = type}; });
         };
 
@@ -122,40 +186,44 @@ namespace cps::search {
         /// @param env stored environment variables
         /// @return A vector of paths to search, in order
         std::vector<SearchPath> search_paths(const Env & env) {
-
-            if (!cached_paths.empty()) {
-                return cached_paths;
-            }
+            trace::Span span{"search_paths"};
+            std::vector<SearchPath> search_paths{};
 
             if (env.cps_path) {
-                add_to_search_path(*env.cps_path, SearchPathType::cps);
+                add_to_search_path(search_paths, *env.cps_path, SearchPathType::cps);
             }
 
             if (env.cps_prefix_path) {
                 auto && prefixes = env.cps_prefix_path.value();
                 for (auto && p : prefixes) {
                     auto && paths = expand_prefix(p);
-                    add_to_search_path(paths, SearchPathType::cps);
+                    add_to_search_path(search_paths, paths, SearchPathType::cps);
                 }
             }
 
             // If PKG_CONFIG_PATH is defined, search for PC files in the specified directly before falling back to
             // system default CPS and PC search paths.
             if (env.pc_path) {
-                add_to_search_path(*env.pc_path, SearchPathType::pc);
+                add_to_search_path(search_paths, *env.pc_path, SearchPathType::pc);
             }
 
             for (auto && p : nix_prefix) {
                 auto && paths = expand_prefix(p);
-                add_to_search_path(paths, SearchPathType::cps);
-                add_to_search_path(paths, SearchPathType::pc);
+                add_to_search_path(search_paths, paths, SearchPathType::cps);
+                add_to_search_path(search_paths, paths, SearchPathType::pc);
             }
 
-            return cached_paths;
+            return search_paths;
         }
 
-        std::optional<fs::path> find_library_in_path(std::string_view name, const SearchPath & search_path) {
+        void count(std::atomic<uint64_t> & counter, uint64_t n = 1) { counter.fetch_add(n, std::memory_order_relaxed); }
+
+        std::optional<fs::path> find_library_in_path(std::string_view name, const SearchPath & search_path,
+                                                     Stats & stats) {
+            count(stats.stat_calls);
             if (fs::is_directory(search_path.path)) {
+                count(stats.directories_scanned);
+                count(stats.stat_calls);
                 const std::string extension = search_path.type == SearchPathType::cps ? "cps" : "pc";
                 // TODO: <name-like>
                 if (fs::path file = search_path.path / fmt::format("{}.{}", name, extension);
@@ -169,8 +237,10 @@ namespace cps::search {
         /// @brief Find all possible paths for a given CPS name
         /// @param name The name of the CPS file to find
         /// @return A vector of paths which patch the given name, or an error
-        tl::expected<std::vector<fs::path>, std::string> find_paths(std::string_view name, Env env) {
+        tl::expected<std::vector<fs::path>, std::string>
+        find_paths(std::string_view name, const std::vector<SearchPath> & search_paths, Stats & stats) {
             // If a path is passed, then just return that.
+            count(stats.stat_calls);
             if (fs::is_regular_file(name)) {
                 return std::vector<fs::path>{name};
             }
@@ -180,10 +250,9 @@ namespace cps::search {
             // a file
             // TODO: what to do about finding multiple versions of the same
             // dependency?
-            auto && paths = search_paths(env);
             std::vector<fs::path> found{};
-            for (auto && search_path : paths) {
-                if (auto file = find_library_in_path(name, search_path)) {
+            for (auto && search_path : search_paths) {
+                if (auto file = find_library_in_path(name, search_path, stats)) {
                     found.push_back(*file);
                 }
             }
@@ -202,75 +271,338 @@ namespace cps::search {
             ProcessedRequires(std::string s) : components{{std::move(s)}}, defaults{false} {};
         };
 
+        using ProcessedRequiresList = std::vector<std::pair<std::string, ProcessedRequires>>;
+
+        ProcessedRequires * find_requires(ProcessedRequiresList & list, std::string_view name) {
+            auto && it = std::find_if(list.begin(), list.end(), [name](auto && r) { return r.first == name; });
+            return it == list.end() ? nullptr : &it->second;
+        }
+
         /// @brief Extract all required dependencies with their components
         /// @param components The requested components
-        /// @return a map of dependency to (components[], use_defaults)
-        std::unordered_map<std::string, ProcessedRequires>
-        process_requires(const std::vector<std::string> & components) {
-            std::unordered_map<std::string, ProcessedRequires> map;
+        /// @return a list of dependency to (components[], use_defaults), in the order they are first required
+        ProcessedRequiresList process_requires(const std::vector<std::string> & components) {
+            ProcessedRequiresList list;
             for (auto && c : components) {
                 std::vector<std::string> vals = utils::split(c);
                 if (vals.size() == 1) {
                     // In this case we want to use the default components
                     // TODO: it's probably an error for one CPS file to specify
                     // the same component with default and non-default?
-                    if (auto x = map.find(vals[0]); x != map.end()) {
+                    if (auto x = find_requires(list, vals[0])) {
                         /// XXX: blarg this is ugly
-                        x->second.defaults = true;
+                        x->defaults = true;
                     } else {
-                        map.emplace(vals[0], ProcessedRequires{true});
+                        list.emplace_back(vals[0], ProcessedRequires{true});
                     }
                 } else {
                     // "" is a special value that means "this dependency"
-                    if (auto x = map.find(vals[0]); x != map.end()) {
+                    if (auto x = find_requires(list, vals[0])) {
                         /// XXX: blarg this is ugly
-                        x->second.components.emplace_back(vals[1]);
+                        x->components.emplace_back(vals[1]);
                     } else {
-                        map.emplace(vals[0], vals[1]);
+                        list.emplace_back(vals[0], vals[1]);
+                    }
+                }
+            }
+            return list;
+        }
+
+    } // namespace
+
+    struct Session::Cache {
+        Cache(const Env & env)
+            : search_paths{search::search_paths(env)},
+              system_includes{env.keep_system_cflags
+                                  ? nullptr
+                                  : system_dirs(env.system_include_path, CPS_CONFIG_SYSTEM_INCLUDE_PATH, {"include"})},
+              system_libdirs{env.keep_system_libs ? nullptr
+                                                  : system_dirs(env.system_library_path, CPS_CONFIG_SYSTEM_LIBRARY_PATH,
+                                                                {platform::libdir(), "lib"})} {};
+
+        Stats stats;
+
+        using Paths = tl::expected<std::vector<fs::path>, std::string>;
+        using LoadedPackage = tl::expected<std::shared_ptr<const loader::Package>, std::string>;
+
+        /// @brief The expanded search paths, which do not change for the life of the session
+        const std::vector<SearchPath> search_paths;
+        /// @brief The directories left out of every result, or null if they are kept
+        const SystemDirs system_includes;
+        const SystemDirs system_libdirs;
+
+        /// @brief Guards the maps below. Entries are only ever added, and their values never change once set
+        std::shared_mutex lock;
+        /// @brief The files found for a name
+        std::unordered_map<std::string, std::shared_future<Paths>> paths;
+        /// @brief Loaded files, or the error loading them, by path
+        std::unordered_map<std::string, std::shared_future<LoadedPackage>> packages;
+    };
+
+    namespace {
+
+        /// @brief Get a value from a Session cache, calculating it if this is the first request for it
+        ///
+        /// If another thread is already calculating the value, this waits for
+        /// it rather than calculating it again.
+        template <typename T, typename F>
+        const T & get_or_create(std::shared_mutex & lock, std::unordered_map<std::string, std::shared_future<T>> & map,
+                                std::string key, F && create) {
+            std::shared_future<T> future;
+            {
+                const std::shared_lock<std::shared_mutex> guard{lock};
+                if (auto && hit = map.find(key); hit != map.end()) {
+                    future = hit->second;
+                }
+            }
+            if (future.valid()) {
+                return future.get();
+            }
+
+            std::promise<T> promise;
+            bool inserted = false;
+            {
+                const std::unique_lock<std::shared_mutex> guard{lock};
+                auto && [entry, added] = map.try_emplace(std::move(key));
+                if (added) {
+                    entry->second = promise.get_future().share();
+                }
+                // Otherwise another thread got here first
+                inserted = added;
+                future = entry->second;
+            }
+            if (inserted) {
+                try {
+                    promise.set_value(create());
+                } catch (...) {
+                    // Anyone waiting on this gets the same exception
+                    promise.set_exception(std::current_exception());
+                    throw;
+                }
+            }
+            return future.get();
+        }
+
+        /// @brief Find all possible paths for a given CPS name, using the session's cache
+        const Session::Cache::Paths & find_paths(std::string_view name, Session & session) {
+            trace::Span span{"find"};
+            span.arg("name", name);
+            bool hit = true;
+            auto && found = get_or_create(session.cache->lock, session.cache->paths, std::string{name}, [&]() {
+                hit = false;
+                return find_paths(name, session.cache->search_paths, session.cache->stats);
+            });
+            count(hit ? session.cache->stats.path_cache_hits : session.cache->stats.path_cache_misses);
+            span.arg("cache", hit ? "hit" : "miss");
+            return found;
+        }
+
+        Session::Cache::LoadedPackage load_package(const fs::path & path, bool digest, Stats & stats) {
+            trace::Span span{"parse"};
+
+            std::ifstream file;
+            file.open(path);
+            count(stats.open_calls);
+
+            // The whole file is read up front, as it may be hashed as well as
+            // parsed. Seeking is cheaper than asking the filesystem for its size.
+            std::string contents;
+            file.seekg(0, std::ios::end);
+            if (const std::streamoff size = file.tellg(); size > 0) {
+                contents.resize(static_cast<size_t>(size));
+                file.seekg(0);
+                file.read(contents.data(), size);
+                contents.resize(static_cast<size_t>(file.gcount()));
+                count(stats.bytes_read, contents.size());
+                span.arg("bytes", static_cast<int64_t>(contents.size()));
+            }
+            std::istringstream in{contents};
+
+            // Assume file is CPS unless file extension is .pc
+            const bool pc = path.extension() == ".pc";
+            count(pc ? stats.pc_files_parsed : stats.cps_files_parsed);
+            loader::Package package = CPS_TRY(pc ? pc_compat::load(in, path.parent_path()) : loader::load(in, path));
+            if (digest) {
+                package.digest = digest::sha256(contents);
+            }
+            return std::make_shared<const loader::Package>(std::move(package));
+        }
+
+        void prefetch(const std::string & name, Session & session);
+
+        /// @brief Load a file, using the session's cache
+        const Session::Cache::LoadedPackage & get_package(const fs::path & path, Session & session) {
+            trace::Span span{"load"};
+            if (span.active()) {
+                span.arg("path", path.string());
+            }
+            bool hit = true;
+            auto && loaded_package = get_or_create(session.cache->lock, session.cache->packages, path.string(), [&]() {
+                hit = false;
+                auto loaded = load_package(path, session.env.digests, session.cache->stats);
+                // When resolving in parallel, start on the dependencies while
+                // this package is being checked
+                if (auto * pool = scheduler::Pool::current(); pool != nullptr && loaded) {
+                    for (auto && r : loaded.value()->require) {
+                        pool->submit([&session, name = r.first]() { prefetch(name, session); });
                     }
                 }
+                return loaded;
+            });
+            count(hit ? session.cache->stats.package_cache_hits : session.cache->stats.package_cache_misses);
+            span.arg("cache", hit ? "hit" : "miss");
+            return loaded_package;
+        }
+
+        /// @brief Find and load all files for a name, so that they are cached when they are needed
+        void prefetch(const std::string & name, Session & session) {
+            try {
+                if (auto && paths = find_paths(name, session)) {
+                    for (auto && path : paths.value()) {
+                        get_package(path, session);
+                    }
+                }
+            } catch (...) {
+                // Any errors will be reported when the package is used
             }
-            return map;
         }
 
         class NodeFactory {
           public:
-            NodeFactory() = default;
-
-            tl::expected<std::shared_ptr<Node>, std::string> get(std::string_view name, const fs::path & path) {
-                if (auto && hit = cache.find(std::string{name}); hit != cache.end()) {
+            NodeFactory(Session & s) : session{s} {};
+
+            /// @return The node, or the error loading the file, which lives as long as the session
+            ///
+            /// There is one node per file for the life of the factory, so
+            /// the packages required from several places in one query share
+            /// a node.
+            tl::expected<std::shared_ptr<Node>, std::string_view> get(const fs::path & path) {
+                if (auto && hit = cache.find(path.native()); hit != cache.end()) {
                     return hit->second;
                 }
 
-                std::ifstream file;
-                file.open(path);
-
-                // Assume file is CPS unless file extension is .pc
-                auto n = std::make_shared<Node>(CPS_TRY(
-                    path.extension() == ".pc" ? pc_compat::load(file, path.parent_path()) : loader::load(file, path)));
+                // Nodes are modified while calculating components, so only
+                // the package they are created from can be shared between
+                // queries
+                auto && loaded = get_package(path, session);
+                // Not CPS_TRY, which would move the package out of the cache
+                if (!loaded) {
+                    return tl::unexpected(std::string_view{loaded.error()});
+                }
+                auto n = std::make_shared<Node>(loaded.value());
+                count(session.cache->stats.graph_nodes);
 
-                cache.emplace(name, n);
+                cache.emplace(path.native(), n);
                 return n;
             }
 
           private:
-            std::unordered_map<std::string, std::shared_ptr<Node>> cache;
+            Session & session;
+            std::unordered_map<fs::path::string_type, std::shared_ptr<Node>> cache;
+        };
+
+        /// @brief Why a package, or one of the files found for it, was rejected
+        ///
+        /// Most rejections are thrown away, because a later file is accepted,
+        /// or because errors are not being printed. So rather than formatting
+        /// a message for each one, this records what was rejected and why,
+        /// and the message is only formatted by render(). The names, paths,
+        /// packages and requirements referred to must outlive it, they
+        /// belong to the Session or to the query.
+        struct Diagnostic {
+            enum class Kind {
+                /// @brief An error from elsewhere, in `error`
+                error,
+                /// @brief The file at `path` could not be loaded, because of `error`
+                unloadable,
+                /// @brief `package` has no version, but `requirement` needs one
+                no_version,
+                /// @brief The version of `package` could not be compared to the one `requirement` needs
+                invalid_version,
+                /// @brief The version of `package` is older than the one `requirement` needs
+                old_version,
+                /// @brief `package` lacks some of the components `requirement` needs
+                missing_components,
+                /// @brief Every file found for `name` was rejected, for the reasons in `children`
+                package,
+            };
+
+            Kind kind;
+            std::string_view name{};
+            const fs::path * path = nullptr;
+            const loader::Package * package = nullptr;
+            const loader::Requirement * requirement = nullptr;
+            std::string_view error{};
+            std::vector<Diagnostic> children{};
+
+            std::string render() const {
+                switch (kind) {
+                case Kind::error:
+                    return std::string{error};
+                case Kind::unloadable:
+                    return fmt::format("CPS file for '{}', in path '{}', generated the following error: '{}'", name,
+                                       path->string(), error);
+                case Kind::no_version:
+                    return fmt::format("Tried {}, which does not specify a version or compat_version, "
+                                       "but the user requires version {}",
+                                       path->generic_string(), requirement->version.value());
+                case Kind::invalid_version:
+                    // Comparing again is cheaper than keeping every error
+                    return fmt::format("{}: {}", path->string(),
+                                       version::compare(package_version(), version::Operator::lt,
+                                                        requirement->version.value(), package->version_schema)
+                                           .error());
+                case Kind::old_version:
+                    return fmt::format("{} has a version of {}, which is less than the required {}, using the "
+                                       "schema {}",
+                                       path->string(), package_version(), requirement->version.value(),
+                                       to_string(package->version_schema));
+                case Kind::missing_components:
+                    return fmt::format("{} does not implement all of the required components '{}'",
+                                       path->string(), fmt::join(requirement->components, ", "));
+                case Kind::package: {
+                    std::string out = fmt::format("{}:", name);
+                    for (auto && c : children) {
+                        out += "\n  ";
+                        out += c.render();
+                    }
+                    return out;
+                }
+                }
+                abort();
+            }
+
+          private:
+            /// @brief The version requirements are compared against
+            const std::string & package_version() const {
+                return package->compat_version ? package->compat_version.value() : package->version.value();
+            }
         };
 
-        tl::expected<std::shared_ptr<Node>, std::string>
-        build_node(std::string_view name, const loader::Requirement & requirements, NodeFactory factory, Env env) {
-            const std::vector<fs::path> paths = CPS_TRY(find_paths(name, env));
-            std::vector<std::string> errors{};
+        /// @param follow_requires Whether to build the nodes of required packages, and reject files whose
+        /// requirements cannot be found
+        tl::expected<std::shared_ptr<Node>, Diagnostic>
+        build_node(std::string_view name, const loader::Requirement & requirements, NodeFactory & factory,
+                   Session & session, bool follow_requires = true) {
+            Stats & stats = session.cache->stats;
+            auto && maybe_paths = find_paths(name, session);
+            if (!maybe_paths) {
+                return tl::unexpected(Diagnostic{.kind = Diagnostic::Kind::error, .error = maybe_paths.error()});
+            }
+            const std::vector<fs::path> & paths = maybe_paths.value();
+            Diagnostic rejected{.kind = Diagnostic::Kind::package, .name = name};
             for (auto && path : paths) {
-                auto maybe_node = factory.get(name, path);
+                auto maybe_node = factory.get(path);
                 if (!maybe_node) {
-                    errors.emplace_back(
-                        fmt::format("CPS file for '{}', in path '{}', generated the following error: '{}'", name,
-                                    path.string(), maybe_node.error()));
+                    count(stats.rejected_unloadable);
+                    rejected.children.emplace_back(Diagnostic{.kind = Diagnostic::Kind::unloadable,
+                                                              .name = name,
+                                                              .path = &path,
+                                                              .error = maybe_node.error()});
                     continue;
                 }
-                auto node = maybe_node.value();
-                const loader::Package & p = node->data.package;
+                auto node = std::move(maybe_node.value());
+                const loader::Package & p = *node->data.package;
 
                 // If this package doesn't meet the requirements then reject it and continue on.
                 // The conditions it couldIf we  fail to meet are:
@@ -283,9 +615,9 @@ namespace cps::search {
                     // > If not provided, the CPS will not satisfy any request for
                     // > a specific version of the package.
                     if (!(p.version || p.compat_version)) {
-                        errors.emplace_back(fmt::format("Tried {}, which does not specify a version or compat_version, "
-                                                        "but the user requires version {}",
-                                                        path.generic_string(), requirements.version.value()));
+                        count(stats.rejected_version);
+                        rejected.children.emplace_back(Diagnostic{
+                            .kind = Diagnostic::Kind::no_version, .path = &path, .requirement = &requirements});
                         continue;
                     }
                     // From the CPS spec, version 0.12.0, for package::compat_version
@@ -302,100 +634,93 @@ namespace cps::search {
                     auto && v = version::compare(p.compat_version.value_or(p.version.value()), version::Operator::lt,
                                                  requirements.version.value(), p.version_schema);
                     if (!v) {
-                        errors.emplace_back(fmt::format("{}: {}", path.string(), v.error()));
+                        count(stats.rejected_version);
+                        rejected.children.emplace_back(Diagnostic{.kind = Diagnostic::Kind::invalid_version,
+                                                                  .path = &path,
+                                                                  .package = &p,
+                                                                  .requirement = &requirements});
                         continue;
                     }
 
                     if (v.value()) {
-                        errors.emplace_back(fmt::format(
-                            "{} has a version of {}, which is less than the required {}, using the schema {}",
-                            path.string(), p.compat_version.value_or(p.version.value()), requirements.version.value(),
-                            to_string(p.version_schema)));
+                        count(stats.rejected_version);
+                        rejected.children.emplace_back(Diagnostic{.kind = Diagnostic::Kind::old_version,
+                                                                  .path = &path,
+                                                                  .package = &p,
+                                                                  .requirement = &requirements});
                         continue;
                     }
                 }
 
                 if (!std::all_of(requirements.components.begin(), requirements.components.end(),
-                                 [p](const std::string & c) { return p.components.find(c) != p.components.end(); })) {
+                                 [&p](const std::string & c) { return p.components.find(c) != p.components.end(); })) {
                     // TODO: more fine grained error message
-                    errors.emplace_back(fmt::format("{} does not implement all of the required components '{}'",
-                                                    path.string(), fmt::join(requirements.components, ", ")));
+                    count(stats.rejected_components);
+                    rejected.children.emplace_back(Diagnostic{
+                        .kind = Diagnostic::Kind::missing_components, .path = &path, .requirement = &requirements});
                     continue;
                 }
 
+                if (!follow_requires || node->resolved) {
+                    return node;
+                }
+
                 std::vector<std::shared_ptr<Node>> found;
                 found.reserve(p.require.size());
                 for (auto && [n, r] : p.require) {
-                    auto && child = build_node(n, r, factory, env);
+                    auto && child = build_node(n, r, factory, session);
 
                     if (child) {
                         found.emplace_back(child.value());
                     } else {
-                        errors.emplace_back(child.error());
+                        rejected.children.emplace_back(std::move(child.error()));
                         break;
                     }
                 }
                 if (found.size() < p.require.size()) {
+                    count(stats.rejected_requires);
                     continue;
                 }
 
-                node->depends.insert(node->depends.end(), found.begin(), found.end());
+                count(stats.graph_edges, found.size());
+                node->required = std::move(found);
+                node->resolved = true;
                 return node;
             }
 
-            return tl::unexpected(fmt::format("{}:\n  {}", name, fmt::join(errors, "\n  ")));
+            return tl::unexpected(std::move(rejected));
         }
 
-        tl::expected<std::shared_ptr<Node>, std::string> build_node(std::string_view name,
-                                                                    const loader::Requirement & requirements, Env env) {
-            NodeFactory factory{};
-            return build_node(name, requirements, factory, env);
-        }
-
-        template <typename T, typename U>
-        void merge_result(const std::unordered_map<T, std::vector<U>> & input,
-                          std::unordered_map<T, std::vector<U>> & output) {
-            for (auto && [l, vals] : input) {
-                output[l].insert(output[l].end(), vals.begin(), vals.end());
-            }
-        }
-
-        template <typename T, typename U>
-        void merge_result(const std::unordered_map<T, std::vector<U>> & input,
-                          std::unordered_map<T, std::vector<U>> & output,
-                          const std::function<U(const U &)> transformer) {
-            for (auto && [l, vals] : input) {
-                std::transform(vals.begin(), vals.end(), std::back_inserter(output[l]), transformer);
-            }
-        }
-
-        template <typename T> void merge_result(const std::vector<T> & input, std::vector<T> & output) {
-            output.insert(output.end(), input.begin(), input.end());
-        }
-
-        template <typename T> void merge_result(const std::optional<T> & input, std::vector<T> & output) {
-            if (input) {
-                output.emplace_back(input.value());
-            }
+        tl::expected<std::shared_ptr<Node>, Diagnostic>
+        build_node(std::string_view name, const loader::Requirement & requirements, Session & session) {
+            NodeFactory factory{session};
+            return build_node(name, requirements, factory, session);
         }
 
         /// @brief Calculate the required components in the graph
         /// @param node The node to process
         /// @param components the components required from this node
-        void set_components(std::shared_ptr<Node> node, std::vector<std::string> components, bool default_components,
-                            bool link_only = false) {
-            const auto & component_updater = [&node, &link_only](std::string name) {
-                if (const auto & entry = node->data.components.find(name); entry != node->data.components.end()) {
-                    entry->second.link_only |= link_only;
+        void set_components(const std::shared_ptr<Node> & node, const std::vector<std::string> & components,
+                            bool default_components, bool link_only = false) {
+            // A node may be required from several places, it only needs to be
+            // visited again if this adds to what was required of it before
+            bool changed = !node->visited;
+            node->visited = true;
+            const auto & component_updater = [&node, &link_only, &changed](const std::string & name) {
+                if (auto * entry = node->data.find(name)) {
+                    // Only link with it if nothing requires it for compiling either
+                    changed |= entry->link_only && !link_only;
+                    entry->link_only &= link_only;
                 } else {
-                    node->data.components.emplace(std::move(name), ComponentDetails{link_only});
+                    changed = true;
+                    node->data.components.emplace_back(name, ComponentDetails{link_only});
                 }
             };
 
             // Set the components that this package's dependees want
-            if (default_components && node->data.package.default_components) {
-                const auto & defs = node->data.package.default_components.value();
-                components.insert(components.end(), defs.begin(), defs.end());
+            if (default_components && node->data.package->default_components) {
+                const auto & defs = node->data.package->default_components.value();
+                std::for_each(defs.begin(), defs.end(), component_updater);
             }
             // Then add all of the explicitly listed components
             std::for_each(components.begin(), components.end(), component_updater);
@@ -404,28 +729,26 @@ namespace cps::search {
             // This takes the form `"requires": [":a", ":b"]`
             // These must be handled before child dependencies, as they may alter the requirements placed on the
             // children..
-            std::vector<std::pair<std::string, ComponentDetails>> self_requires;
-            std::transform(node->data.components.begin(), node->data.components.end(),
-                           std::back_insert_iterator(self_requires),
-                           [](std::pair<std::string, ComponentDetails> entry) { return entry; });
+            std::vector<std::pair<std::string, ComponentDetails>> self_requires{node->data.components.begin(),
+                                                                                node->data.components.end()};
             std::unordered_set<std::string> processed;
             bool self_defaults = default_components;
             while (!self_requires.empty()) {
-                const auto [this_name, this_comp] = self_requires.back();
+                const auto [this_name, this_comp] = std::move(self_requires.back());
                 self_requires.pop_back();
                 if (processed.find(this_name) != processed.end()) {
                     continue;
                 }
                 processed.emplace(this_name);
 
-                const loader::Component & component = node->data.package.components.at(this_name);
+                const loader::Component & component = node->data.package->components.at(this_name);
                 auto && required = process_requires(component.require);
-                if (auto && self = required.find(""); self != required.end()) {
+                if (auto * self = find_requires(required, "")) {
                     // Don't insert these twice
-                    std::vector<std::string> self_comps = self->second.components;
-                    if (!self_defaults && self->second.defaults && node->data.package.default_components) {
+                    std::vector<std::string> self_comps = std::move(self->components);
+                    if (!self_defaults && self->defaults && node->data.package->default_components) {
                         self_defaults = true;
-                        const std::vector<std::string> & defs = node->data.package.default_components.value();
+                        const std::vector<std::string> & defs = node->data.package->default_components.value();
                         self_comps.insert(self_comps.end(), defs.begin(), defs.end());
                     }
                     std::for_each(self_comps.begin(), self_comps.end(), component_updater);
@@ -434,44 +757,325 @@ namespace cps::search {
                         if (processed.find(comp) != processed.end()) {
                             continue;
                         }
-                        self_requires.emplace_back(std::make_pair(comp, ComponentDetails{link_only}));
+                        self_requires.emplace_back(comp, ComponentDetails{link_only});
                     }
                 }
             }
 
+            if (!changed) {
+                return;
+            }
+
             // Walk the list of components for this component, adding component
             // requirements recursively for external requirements.
-            for (const auto & [this_name, this_comp] : node->data.components) {
-                // It's possible that the Package::Requires section listed
-                // dependencies we don't actually need. If we don't need them we
-                // can trim the graph
-                std::vector<std::shared_ptr<Node>> trimmed;
-
-                // This *should* be validated such that we won't have an exception
-                const loader::Component & component = node->data.package.components.at(this_name);
-                auto && required = process_requires(component.require);
-                for (std::shared_ptr<Node> & child : node->depends) {
-                    if (auto && child_comps = required.find(child->data.package.name); child_comps != required.end()) {
-                        trimmed.emplace_back(child);
-                        set_components(child, child_comps->second.components, child_comps->second.defaults, link_only);
+            //
+            // It's possible that the Package::Requires section listed
+            // dependencies we don't actually need. If we don't need them we
+            // can trim the graph. The children that are kept are in the order
+            // the components require them, so that the graph is sorted the
+            // same way every time.
+            std::vector<std::shared_ptr<Node>> trimmed;
+            const auto & require_children = [&node, &trimmed](const ProcessedRequiresList & required,
+                                                              bool child_link_only) {
+                for (auto && [child_name, child_comps] : required) {
+                    auto && child = std::find_if(
+                        node->required.begin(), node->required.end(),
+                        [&n = child_name](const std::shared_ptr<Node> & d) { return d->data.package->name == n; });
+                    if (child == node->required.end()) {
+                        continue;
                     }
-                }
-                auto && link_required = process_requires(component.link_requires);
-                for (std::shared_ptr<Node> & child : node->depends) {
-                    if (auto && child_comps = link_required.find(child->data.package.name);
-                        child_comps != link_required.end()) {
-                        trimmed.emplace_back(child);
-                        set_components(child, child_comps->second.components, child_comps->second.defaults, true);
+                    if (std::find(trimmed.begin(), trimmed.end(), *child) == trimmed.end()) {
+                        trimmed.emplace_back(*child);
                     }
+                    set_components(*child, child_comps.components, child_comps.defaults, child_link_only);
                 }
-                node->depends = trimmed;
+            };
+            for (const auto & [this_name, this_comp] : node->data.components) {
+                // This *should* be validated such that we won't have an exception
+                const loader::Component & component = node->data.package->components.at(this_name);
+                require_children(process_requires(component.require), link_only);
+                require_children(process_requires(component.link_requires), true);
             }
+            node->depends = std::move(trimmed);
+        }
+
+        /// @brief Remove all but the first value with each key, without changing the order of the others
+        template <typename Key, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>, typename V,
+                  typename F>
+        void keep_first(std::vector<V> & values, F && key) {
+            std::unordered_set<Key, Hash, Equal> seen;
+            seen.reserve(values.size());
+            values.erase(std::remove_if(values.begin(), values.end(),
+                                        [&](const V & v) { return !seen.emplace(key(v)).second; }),
+                         values.end());
+        }
+
+        /// @brief Remove all but the last value with each key, without changing the order of the others
+        template <typename Key, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>, typename V,
+                  typename F>
+        void keep_last(std::vector<V> & values, F && key) {
+            std::reverse(values.begin(), values.end());
+            keep_first<Key, Hash, Equal>(values, key);
+            std::reverse(values.begin(), values.end());
         }
 
+        /// @brief Whether a compile flag takes the argument after it, as in `-isystem <dir>`
+        bool takes_argument(std::string_view flag) {
+            static const std::unordered_set<std::string_view> flags{
+                "-D", "-F", "-I", "-U", "-arch", "-framework", "-idirafter", "-imacros", "-imultilib",
+                "-include", "-iprefix", "-iquote", "-isysroot", "-isystem", "-iwithprefix", "-iwithprefixbefore",
+                "-target", "-x", "-Xassembler", "-Xclang", "-Xlinker", "-Xpreprocessor",
+            };
+            return flags.count(flag) != 0;
+        }
+
+        struct DefineHash {
+            size_t operator()(const loader::Define * d) const {
+                const size_t h = std::hash<std::string>{}(d->get_name());
+                auto && v = d->get_value();
+                return v ? h ^ (std::hash<std::string>{}(v.value()) * 31 + 1) : h;
+            }
+        };
+
+        struct DefineEqual {
+            bool operator()(const loader::Define * l, const loader::Define * r) const { return *l == *r; }
+        };
+
     } // namespace
 
     Result::Result(){};
 
+    std::string to_string(const Stats & stats) {
+        const std::pair<const char *, const std::atomic<uint64_t> &> counters[] = {
+            {"stat calls", stats.stat_calls},
+            {"files opened", stats.open_calls},
+            {"directories scanned", stats.directories_scanned},
+            {"cps files parsed", stats.cps_files_parsed},
+            {"pc files parsed", stats.pc_files_parsed},
+            {"bytes read", stats.bytes_read},
+            {"rejected, could not be loaded", stats.rejected_unloadable},
+            {"rejected, wrong version", stats.rejected_version},
+            {"rejected, missing components", stats.rejected_components},
+            {"rejected, requirements not found", stats.rejected_requires},
+            {"graph nodes", stats.graph_nodes},
+            {"graph edges", stats.graph_edges},
+            {"path cache hits", stats.path_cache_hits},
+            {"path cache misses", stats.path_cache_misses},
+            {"package cache hits", stats.package_cache_hits},
+            {"package cache misses", stats.package_cache_misses},
+        };
+        std::string out;
+        for (auto && [name, value] : counters) {
+            out += fmt::format("{}: {}\n", name, value.load());
+        }
+        return out;
+    }
+
+    const loader::PrefixPath * Result::Entry::location() const {
+        if (component->type == loader::Type::interface) {
+            return nullptr;
+        }
+        if (component->link_location) {
+            return &component->link_location.value();
+        }
+        return component->location ? &component->location.value() : nullptr;
+    }
+
+    void Result::merge(const Result & other) {
+        const size_t offset = prefixes.size();
+        prefixes.insert(prefixes.end(), other.prefixes.begin(), other.prefixes.end());
+        entries.reserve(entries.size() + other.entries.size());
+        for (auto && e : other.entries) {
+            entries.emplace_back(e).prefix += offset;
+        }
+    }
+
+    const fs::path & Result::prefix(const Entry & entry) const { return prefixes[entry.prefix]; }
+
+    std::string Result::digest() const {
+        digest::Sha256 h{};
+        // Bumped whenever what goes into the digest changes
+        h.field("cps-config result 1");
+        h.field(version);
+        h.field(deduplicate ? "deduplicate" : "keep duplicates");
+
+        for (auto && e : entries) {
+            auto && package = *e.package;
+            h.field(package.digest);
+            h.field(package.filename);
+            auto && name = std::find_if(package.components.begin(), package.components.end(),
+                                        [&e](auto && c) { return &c.second == e.component; });
+            h.field(name == package.components.end() ? "" : name->first);
+            h.field(prefix(e).generic_string());
+            h.field(e.link_only ? "link" : "compile and link");
+        }
+
+        // These are sets, so they are sorted to be stable
+        for (auto && dirs : {system_includes, system_libdirs}) {
+            if (dirs == nullptr) {
+                h.field("keep system directories");
+                continue;
+            }
+            std::vector<std::string_view> sorted{dirs->begin(), dirs->end()};
+            std::sort(sorted.begin(), sorted.end());
+            h.field(std::to_string(sorted.size()));
+            for (auto && d : sorted) {
+                h.field(d);
+            }
+        }
+
+        return h.hex();
+    }
+
+    void Result::filter(std::vector<Value<std::string>> & values) const {
+        if (!deduplicate) {
+            return;
+        }
+
+        // A flag which takes the next argument is left alone along with that
+        // argument, as pkgconf does: merging `-include a.h -include b.h` by
+        // token would separate the second `-include` from its argument
+        std::vector<bool> pinned(values.size(), false);
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (takes_argument(*values[i].first)) {
+                pinned[i] = true;
+                if (i + 1 < values.size()) {
+                    pinned[++i] = true;
+                }
+            }
+        }
+
+        std::vector<bool> keep(values.size(), true);
+        std::unordered_set<std::string_view> seen;
+        seen.reserve(values.size());
+        for (size_t i = values.size(); i-- > 0;) {
+            if (!pinned[i]) {
+                keep[i] = seen.emplace(*values[i].first).second;
+            }
+        }
+
+        size_t out = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (keep[i]) {
+                values[out++] = values[i];
+            }
+        }
+        values.resize(out);
+    }
+
+    void Result::filter(std::vector<Value<loader::PrefixPath>> & values) const {
+        if (system_includes == nullptr && !deduplicate) {
+            return;
+        }
+        // Compared once resolved, as the same directory may be reached
+        // through different prefixes
+        std::unordered_set<std::string> seen;
+        values.erase(std::remove_if(values.begin(), values.end(),
+                                    [&](const Value<loader::PrefixPath> & v) {
+                                        std::string dir = system_dir_key(v.first->resolve(prefix(*v.second)));
+                                        if (system_includes != nullptr && system_includes->count(dir) != 0) {
+                                            return true;
+                                        }
+                                        return deduplicate && !seen.emplace(std::move(dir)).second;
+                                    }),
+                     values.end());
+    }
+
+    void Result::filter(std::vector<Value<loader::Define>> & values) const {
+        if (deduplicate) {
+            keep_last<const loader::Define *, DefineHash, DefineEqual>(
+                values, [](const Value<loader::Define> & v) { return v.first; });
+        }
+    }
+
+    void Result::filter(std::vector<Value<loader::LinkFlag>> & values) const {
+        // Libraries and search directories are removed in opposite directions, so mark what to keep first
+        std::vector<bool> keep(values.size(), true);
+        std::unordered_set<std::string_view> seen;
+        if (deduplicate) {
+            seen.reserve(values.size());
+            for (size_t i = values.size(); i-- > 0;) {
+                auto && f = *values[i].first;
+                if (f.type == loader::LinkFlagType::library) {
+                    keep[i] = seen.emplace(f.value).second;
+                }
+            }
+            seen.clear();
+        }
+        for (size_t i = 0; i < values.size(); ++i) {
+            auto && f = *values[i].first;
+            if (f.type != loader::LinkFlagType::search_dir) {
+                continue;
+            }
+            if (system_libdirs != nullptr && system_libdirs->count(system_dir_key(f.value)) != 0) {
+                keep[i] = false;
+            } else if (deduplicate) {
+                keep[i] = seen.emplace(f.value).second;
+            }
+        }
+
+        size_t out = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (keep[i]) {
+                values[out++] = values[i];
+            }
+        }
+        values.resize(out);
+    }
+
+    void Result::filter_locations(std::vector<Value<loader::PrefixPath>> & values) const {
+        if (deduplicate) {
+            keep_last<fs::path::string_type>(values, [this](const Value<loader::PrefixPath> & v) {
+                return v.first->resolve(prefix(*v.second)).native();
+            });
+        }
+    }
+
+    Session::Session(Env e) : env{std::move(e)}, cache{std::make_unique<Cache>(env)} {};
+    Session::~Session() = default;
+    Session::Session(Session &&) noexcept = default;
+    Session & Session::operator=(Session &&) noexcept = default;
+
+    const Stats & Session::stats() const { return cache->stats; }
+
+    const SystemDirs & Session::system_includes() const { return cache->system_includes; }
+    const SystemDirs & Session::system_libdirs() const { return cache->system_libdirs; }
+
+    std::vector<fs::path> Session::inputs() const {
+        // Only the names are copied under the lock, the filesystem is asked about them afterwards
+        std::vector<fs::path> files;
+        std::vector<std::string> names;
+        {
+            const std::shared_lock<std::shared_mutex> guard{cache->lock};
+            files.reserve(cache->packages.size());
+            for (auto && [path, _] : cache->packages) {
+                files.emplace_back(path);
+            }
+            names.reserve(cache->paths.size());
+            for (auto && [name, _] : cache->paths) {
+                names.emplace_back(name);
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        // Names which are paths do not search anything
+        if (std::any_of(names.begin(), names.end(), [](auto && n) { return !fs::is_regular_file(n); })) {
+            std::unordered_set<std::string> seen;
+            for (auto && sp : cache->search_paths) {
+                // A directory which does not exist changes the result once it
+                // is created, which changes its nearest existing parent
+                fs::path dir = sp.path;
+                while (!fs::is_directory(dir) && dir.has_relative_path()) {
+                    dir = dir.parent_path();
+                }
+                if (fs::is_directory(dir) && seen.emplace(dir.string()).second) {
+                    files.emplace_back(std::move(dir));
+                }
+            }
+        }
+        return files;
+    }
+
     tl::expected<Result, std::string> find_package(std::string_view name, Env env) {
         return find_package(name, {}, true, env, std::nullopt);
     }
@@ -479,69 +1083,128 @@ namespace cps::search {
     tl::expected<Result, std::string> find_package(std::string_view name, const std::vector<std::string> & components,
                                                    bool default_components, Env env,
                                                    std::optional<std::string> prefix_variable) {
-        // XXX: do we need process_requires here?
-        auto && root = CPS_TRY(build_node(name, loader::Requirement{components}, env));
-        // This has to be done as a two step pass, since we want to trim any
-        // unnecessary nodes from the graph, but we cannot do that while finding,
-        // since we could have a diamond dependency, where the two dependees have
-        // different components they want.
-        set_components(root, components, default_components);
-        auto && flat = tsort(root);
+        Session session{std::move(env)};
+        return find_package(session, name, components, default_components, prefix_variable);
+    }
 
+    tl::expected<Result, std::string> find_package(Session & session, std::string_view name,
+                                                   const std::vector<std::string> & components,
+                                                   bool default_components,
+                                                   const std::optional<std::string> & prefix_variable) {
+        trace::Span span{"find_package"};
+        span.arg("name", name);
+
+        std::shared_ptr<Node> root;
+        {
+            trace::Span build_span{"build_graph"};
+            // XXX: do we need process_requires here?
+            const loader::Requirement requirement{components};
+            auto && built = build_node(name, requirement, session);
+            if (!built) {
+                // The diagnostic refers to the requirement, so must be rendered here
+                return tl::unexpected(built.error().render());
+            }
+            root = std::move(built.value());
+        }
+        {
+            trace::Span components_span{"set_components"};
+            // This has to be done as a two step pass, since we want to trim any
+            // unnecessary nodes from the graph, but we cannot do that while finding,
+            // since we could have a diamond dependency, where the two dependees have
+            // different components they want.
+            set_components(root, components, default_components);
+        }
+        std::vector<std::shared_ptr<Node>> flat;
+        {
+            trace::Span tsort_span{"tsort"};
+            flat = tsort(root);
+        }
+
+        trace::Span merge_span{"merge"};
         Result result{};
 
-        result.version = root->data.package.version.value_or("unknown");
+        result.version = root->data.package->version.value_or("unknown");
+        result.system_includes = session.cache->system_includes;
+        result.system_libdirs = session.cache->system_libdirs;
 
-        const auto prefix_path =
-            prefix_variable.has_value() ? std::optional{fs::path{prefix_variable.value()}} : std::nullopt;
+        // Only the components are recorded, their arguments are used in
+        // place, and paths are resolved against the prefix when they are used
+        if (prefix_variable) {
+            result.prefixes.emplace_back(prefix_variable.value());
+        } else {
+            result.prefixes.reserve(flat.size());
+        }
 
         for (auto && node : flat) {
-
-            const auto prefix = prefix_path.value_or(node->data.package.prefix);
-
-            const auto && prefix_replacer = [&](const fs::path & p) -> fs::path {
-                if (p.begin()->generic_string() == "@prefix@") {
-                    fs::path replacedPath = prefix;
-                    for (auto it = ++p.begin(); it != p.end(); ++it) {
-                        replacedPath /= *it;
-                    }
-                    return replacedPath.string();
-                }
-                return p;
-            };
+            if (!prefix_variable) {
+                result.prefixes.emplace_back(node->data.package->prefix);
+            }
+            const size_t prefix = result.prefixes.size() - 1;
 
             for (const auto & [comp_name, cps_comp] : node->data.components) {
                 // We should have already errored if this is not the case
-                auto && f = node->data.package.components.find(comp_name);
-                utils::assert_fn(
-                    f != node->data.package.components.end(),
-                    fmt::format("Could not find component {} of package {}", comp_name, node->data.package.name));
+                auto && f = node->data.package->components.find(comp_name);
+                if (f == node->data.package->components.end()) {
+                    // Only format the message when it is needed
+                    utils::assert_fn(false, fmt::format("Could not find component {} of package {}", comp_name,
+                                                        node->data.package->name));
+                }
                 auto && comp = f->second;
 
-                // Convert prefix at this point because:
-                // 1. we are about to lose which CPS file the information came
-                // from
-                // 2. if we do it at the search point we have to plumb overrides
-                // deep into that
-                if (!cps_comp.link_only) {
-                    merge_result<loader::KnownLanguages, fs::path>(comp.includes, result.includes, prefix_replacer);
-                    merge_result(comp.definitions, result.definitions);
-                    merge_result(comp.compile_flags, result.compile_flags);
-                }
-                merge_result(comp.link_libraries, result.link_libraries);
-                merge_result(comp.link_flags, result.link_flags);
-                if (comp.type != loader::Type::interface) {
-                    if (!comp.location) {
-                        return tl::make_unexpected(
-                            fmt::format("Component `{}` requires 'location' attribute", comp_name));
-                    }
-                    result.link_location.emplace_back(
-                        prefix_replacer(comp.link_location.value_or(comp.location.value())));
+                if (comp.type != loader::Type::interface && !comp.location) {
+                    return tl::make_unexpected(fmt::format("Component `{}` requires 'location' attribute", comp_name));
                 }
+                result.entries.emplace_back(Result::Entry{.package = node->data.package,
+                                                          .component = &comp,
+                                                          .prefix = prefix,
+                                                          .link_only = cps_comp.link_only});
             }
         }
 
         return result;
     }
 
+    tl::expected<std::shared_ptr<const loader::Package>, std::string>
+    probe_package(Session & session, std::string_view name, const std::vector<std::string> & components,
+                  bool follow_requires) {
+        trace::Span span{"probe_package"};
+        span.arg("name", name);
+        const loader::Requirement requirement{components};
+        NodeFactory factory{session};
+        auto && built = build_node(name, requirement, factory, session, follow_requires);
+        if (!built) {
+            return tl::unexpected(built.error().render());
+        }
+        return built.value()->data.package;
+    }
+
+    std::vector<tl::expected<Result, std::string>> find_packages(Session & session, const std::vector<Query> & queries,
+                                                                 size_t threads) {
+        std::vector<tl::expected<Result, std::string>> results(queries.size(), tl::unexpected(std::string{}));
+        if (threads <= 1 || queries.size() <= 1) {
+            // Not worth starting a thread for
+            for (size_t i = 0; i < queries.size(); ++i) {
+                auto && q = queries[i];
+                results[i] = find_package(session, q.name, q.components, q.default_components, q.prefix_variable);
+            }
+            return results;
+        }
+        {
+            // Each query is a single task, so more threads than queries would only sit idle
+            scheduler::Pool pool{std::min(threads, queries.size())};
+            for (size_t i = 0; i < queries.size(); ++i) {
+                pool.submit([&session, &query = queries[i], &result = results[i]]() {
+                    try {
+                        result = find_package(session, query.name, query.components, query.default_components,
+                                              query.prefix_variable);
+                    } catch (const std::exception & e) {
+                        result = tl::unexpected(fmt::format("Error finding {}: {}", query.name, e.what()));
+                    }
+                });
+            }
+            pool.wait();
+        }
+        return results;
+    }
+
 } // namespace cps::search
@@ -5,32 +5,243 @@
 
 #include "cps/env.hpp"
 #include "cps/loader.hpp"
+#include "cps/scheduler.hpp"
 
 #include <tl/expected.hpp>
 
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace cps::search {
 
     namespace fs = std::filesystem;
 
+    /// @brief Directories the compiler or linker searches anyway, which are left out of results
+    ///
+    /// Directories are in generic form, without a trailing separator. Null
+    /// when they are kept.
+    using SystemDirs = std::shared_ptr<const std::unordered_set<std::string>>;
+
+    /// @brief The components used by a query, and the prefix of each
+    ///
+    /// Rather than copying the arguments out of each component, a Result
+    /// refers to the loaded packages, so building one costs the same however
+    /// many arguments the components have. The arguments of all of the
+    /// components are visited in order with for_each_compile() and
+    /// for_each_link().
     class Result {
       public:
+        /// @brief A component, and how it is used
+        struct Entry {
+            /// @brief The package the component belongs to, which is kept alive by the Result
+            std::shared_ptr<const loader::Package> package;
+            const loader::Component * component;
+            /// @brief The index of the prefix to resolve the component's paths with
+            size_t prefix;
+            /// @brief Only link arguments are used from this component
+            bool link_only;
+
+            /// @brief The file to link, if any
+            const loader::PrefixPath * location() const;
+        };
+
         Result();
 
+        /// @brief Append the components of another result to this one, the version is not changed
+        void merge(const Result & other);
+
+        /// @brief The prefix that the paths of an entry are relative to
+        const fs::path & prefix(const Entry & entry) const;
+
+        /// @brief A SHA-256 digest of everything the arguments are built from, as lowercase hex
+        ///
+        /// This covers the version, each entry's component and prefix, the
+        /// digest of the file each entry's package was loaded from, and the
+        /// options which change which arguments are visited. If the digest
+        /// is unchanged, so are the arguments, so it can be used as a cache
+        /// key without printing them. It is only stable for one version of
+        /// cps-config. The files are only covered if the session that found
+        /// the result was asked for digests, see Env::digests.
+        std::string digest() const;
+
+        /// @brief Call `f(value, entry)` for every value of a compile argument, for one language
+        ///
+        /// Components which are only used for linking are skipped, as are
+        /// the include directories in system_includes.
+        ///
+        /// Unless deduplicate is false, repeated values are skipped as
+        /// pkgconf does: only the first of each include directory is kept,
+        /// since that is the one the compiler would search, and only the last
+        /// of each compile flag and definition is kept, since that is the one
+        /// that takes effect. Flags which take the next argument, such as
+        /// `-isystem <dir>` or `-include <file>`, are never merged, and
+        /// neither are their arguments.
+        /// @param field The field of loader::Component to visit, like `&loader::Component::includes`
+        template <typename T, typename F>
+        void for_each_compile(const std::unordered_map<loader::KnownLanguages, std::vector<T>> loader::Component::*field,
+                              loader::KnownLanguages lang, F && f) const {
+            std::vector<Value<T>> values;
+            for (auto && e : entries) {
+                if (e.link_only) {
+                    continue;
+                }
+                auto && lang_values = e.component->*field;
+                if (auto && found = lang_values.find(lang); found != lang_values.end()) {
+                    for (auto && v : found->second) {
+                        values.emplace_back(&v, &e);
+                    }
+                }
+            }
+            filter(values);
+            for (auto && [v, e] : values) {
+                f(*v, *e);
+            }
+        }
+
+        /// @brief Call `f(value, entry)` for every value of a link argument
+        ///
+        /// The `-L` directories in system_libdirs are skipped.
+        ///
+        /// Unless deduplicate is false, the link line is compacted: only the
+        /// last of each library is kept, so that it still comes after
+        /// everything that uses it when linking statically, and only the
+        /// first of each `-L` directory is kept. Other link flags may depend
+        /// on where they are, like `-Wl,--whole-archive`, so all of them are
+        /// kept.
+        /// @param field The field of loader::Component to visit, like `&loader::Component::link_flags`
+        template <typename T, typename F>
+        void for_each_link(const std::vector<T> loader::Component::*field, F && f) const {
+            std::vector<Value<T>> values;
+            for (auto && e : entries) {
+                for (auto && v : e.component->*field) {
+                    values.emplace_back(&v, &e);
+                }
+            }
+            filter(values);
+            for (auto && [v, e] : values) {
+                f(*v, *e);
+            }
+        }
+
+        /// @brief Call `f(location, entry)` for every file to link
+        ///
+        /// Unless deduplicate is false, only the last of each file is kept, like libraries in for_each_link().
+        template <typename F>
+        void for_each_location(F && f) const {
+            std::vector<Value<loader::PrefixPath>> values;
+            for (auto && e : entries) {
+                if (auto && l = e.location()) {
+                    values.emplace_back(l, &e);
+                }
+            }
+            filter_locations(values);
+            for (auto && [v, e] : values) {
+                f(*v, *e);
+            }
+        }
+
         std::string version;
-        loader::LangPaths includes;
-        loader::LangStrings compile_flags;
-        loader::Defines definitions;
-        std::vector<std::string> link_flags;
-        std::vector<std::string> link_libraries;
-        std::vector<fs::path> link_location;
+        /// @brief The components, in the order their arguments are used
+        std::vector<Entry> entries;
+        /// @brief The prefixes of the entries
+        std::vector<fs::path> prefixes;
+        /// @brief Whether repeated arguments are skipped when visiting them
+        bool deduplicate = true;
+        /// @brief Include directories skipped when visiting includes, shared by the results of a Session
+        SystemDirs system_includes;
+        /// @brief Library directories skipped when visiting `-L` flags
+        SystemDirs system_libdirs;
+
+      private:
+        template <typename T>
+        using Value = std::pair<const T *, const Entry *>;
+
+        /// @brief Remove the values which should not be visited
+        void filter(std::vector<Value<std::string>> & values) const;
+        void filter(std::vector<Value<loader::PrefixPath>> & values) const;
+        void filter(std::vector<Value<loader::Define>> & values) const;
+        void filter(std::vector<Value<loader::LinkFlag>> & values) const;
+        void filter_locations(std::vector<Value<loader::PrefixPath>> & values) const;
+    };
+
+    /// @brief Counts of the work done by a Session, to find out why queries are slow
+    struct Stats {
+        /// @brief Filesystem metadata queries, like checking whether a file exists
+        std::atomic<uint64_t> stat_calls{0};
+        std::atomic<uint64_t> open_calls{0};
+        /// @brief Search path directories probed for a file
+        std::atomic<uint64_t> directories_scanned{0};
+        std::atomic<uint64_t> cps_files_parsed{0};
+        std::atomic<uint64_t> pc_files_parsed{0};
+        std::atomic<uint64_t> bytes_read{0};
+        /// @brief Candidate files rejected because they could not be loaded
+        std::atomic<uint64_t> rejected_unloadable{0};
+        /// @brief Candidate files rejected because they do not provide the required version
+        std::atomic<uint64_t> rejected_version{0};
+        /// @brief Candidate files rejected because they do not provide the required components
+        std::atomic<uint64_t> rejected_components{0};
+        /// @brief Candidate files rejected because one of their requirements could not be satisfied
+        std::atomic<uint64_t> rejected_requires{0};
+        std::atomic<uint64_t> graph_nodes{0};
+        std::atomic<uint64_t> graph_edges{0};
+        std::atomic<uint64_t> path_cache_hits{0};
+        std::atomic<uint64_t> path_cache_misses{0};
+        std::atomic<uint64_t> package_cache_hits{0};
+        std::atomic<uint64_t> package_cache_misses{0};
+    };
+
+    /// @brief Format the counters as `name: value` lines
+    std::string to_string(const Stats & stats);
+
+    /// @brief State that is kept between multiple queries
+    ///
+    /// The search paths are calculated from the Env when the Session is
+    /// created, and located and loaded files are cached for the lifetime of
+    /// the Session, so that running many queries does not require reading the
+    /// same files again. A Session may be queried from several threads at
+    /// once, each file is only located and loaded once however many threads
+    /// ask for it.
+    class Session {
+      public:
+        explicit Session(Env env);
+        ~Session();
+        Session(Session &&) noexcept;
+        Session & operator=(Session &&) noexcept;
+
+        /// @brief The environment the Session was created with, changing it does not change the search paths
+        Env env;
+
+        /// @brief The work done by all queries using this Session so far
+        const Stats & stats() const;
+
+        /// @brief The directories left out of the results of this Session
+        const SystemDirs & system_includes() const;
+        const SystemDirs & system_libdirs() const;
+
+        /// @brief The files and directories that the queries run so far depend on
+        ///
+        /// This is every file loaded, whether or not it was used, and every
+        /// search directory that was looked in, including those where
+        /// nothing was found, as adding a file there could change the
+        /// result. A directory that does not exist is replaced by its nearest
+        /// parent that does, which changes when it is created. Files come
+        /// first, sorted, then directories in the order they are searched.
+        std::vector<fs::path> inputs() const;
+
+        /// @brief Implementation detail of the search module
+        struct Cache;
+        std::unique_ptr<Cache> cache;
     };
 
     // TODO: restrictions like versions
-    // TODO: caching loading packages?
     // TODO: multiple versions of packages?
     tl::expected<Result, std::string> find_package(std::string_view name, Env env);
 
@@ -39,4 +250,39 @@ namespace cps::search {
                                                    bool default_components, Env env,
                                                    std::optional<std::string> prefix_variable);
 
+    /// @brief Find a package, reusing the files already loaded by the session
+    tl::expected<Result, std::string> find_package(Session & session, std::string_view name,
+                                                   const std::vector<std::string> & components,
+                                                   bool default_components,
+                                                   const std::optional<std::string> & prefix_variable);
+
+    /// @brief Find the file a package is loaded from, without working out which components are used
+    ///
+    /// This is all that is needed to check that a package exists, or what
+    /// its version is, and skips the work find_package does to choose
+    /// components and collect their arguments.
+    /// @param follow_requires Whether to also find everything the package requires, rejecting files whose
+    /// requirements cannot be found, in which case the file chosen is the one find_package would use. If false,
+    /// only the first file for the package which has the components is loaded.
+    tl::expected<std::shared_ptr<const loader::Package>, std::string>
+    probe_package(Session & session, std::string_view name, const std::vector<std::string> & components,
+                  bool follow_requires = true);
+
+    /// @brief The arguments to find_package, for queries run together
+    struct Query {
+        std::string name;
+        std::vector<std::string> components = {};
+        bool default_components = true;
+        std::optional<std::string> prefix_variable = std::nullopt;
+    };
+
+    /// @brief Find many packages in parallel
+    ///
+    /// Each query is resolved on a pool of threads, and the files each package
+    /// requires are loaded ahead of time by the pool, so independent parts of
+    /// the dependency graphs are loaded concurrently.
+    /// @return A result for each query, in the same order as the queries
+    std::vector<tl::expected<Result, std::string>> find_packages(Session & session, const std::vector<Query> & queries,
+                                                                 size_t threads = scheduler::default_threads());
+
 } // namespace cps::search
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/trace.hpp"
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+#include <mutex>
+
+namespace cps::trace {
+
+    namespace {
+
+        /// @brief A finished span
+        struct Event {
+            const char * name;
+            const char * category;
+            std::chrono::steady_clock::time_point start;
+            std::chrono::steady_clock::duration duration;
+            uint32_t thread;
+            std::vector<Span::Arg> args;
+        };
+
+        struct Recorder {
+            std::mutex lock;
+            fs::path output;
+            std::chrono::steady_clock::time_point epoch;
+            std::vector<Event> events;
+        };
+
+        Recorder & recorder() {
+            static Recorder r{};
+            return r;
+        }
+
+        /// @brief A small, stable number for the calling thread, as trace viewers expect
+        uint32_t thread_id() {
+            static std::atomic<uint32_t> next{1};
+            thread_local const uint32_t id = next.fetch_add(1);
+            return id;
+        }
+
+        double to_us(std::chrono::steady_clock::duration d) {
+            return std::chrono::duration<double, std::micro>(d).count();
+        }
+
+    } // namespace
+
+    void start(fs::path output) {
+        auto && r = recorder();
+        {
+            const std::lock_guard<std::mutex> guard{r.lock};
+            r.output = std::move(output);
+            r.epoch = std::chrono::steady_clock::now();
+            r.events.clear();
+        }
+        detail::recording.store(true);
+    }
+
+    tl::expected<void, std::string> finish() {
+        if (!detail::recording.exchange(false)) {
+            return {};
+        }
+
+        auto && r = recorder();
+        const std::lock_guard<std::mutex> guard{r.lock};
+
+        nlohmann::json events = nlohmann::json::array();
+        for (auto && e : r.events) {
+            nlohmann::json args = nlohmann::json::object();
+            for (auto && [key, value] : e.args) {
+                std::visit([&args, k = key](auto && v) { args[k] = v; }, value);
+            }
+            events.push_back({
+                {"name", e.name},
+                {"cat", e.category},
+                {"ph", "X"},
+                {"ts", to_us(e.start - r.epoch)},
+                {"dur", to_us(e.duration)},
+                {"pid", 1},
+                {"tid", e.thread},
+                {"args", std::move(args)},
+            });
+        }
+        r.events.clear();
+
+        std::ofstream out{r.output};
+        if (!out) {
+            return tl::unexpected(fmt::format("Could not open trace file {}", r.output.string()));
+        }
+        out << nlohmann::json{{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}}.dump() << '\n';
+        return {};
+    }
+
+    void Span::begin(const char * name, const char * category) {
+        span_name = name;
+        span_category = category;
+        started = std::chrono::steady_clock::now();
+    }
+
+    void Span::end() {
+        const auto duration = std::chrono::steady_clock::now() - started;
+        auto && r = recorder();
+        const std::lock_guard<std::mutex> guard{r.lock};
+        // Recording may have finished while this span was open
+        if (enabled()) {
+            r.events.emplace_back(
+                Event{span_name, span_category, started, duration, thread_id(), std::move(args)});
+        }
+    }
+
+} // namespace cps::trace
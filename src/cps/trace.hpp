@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#pragma once
+
+#include <tl/expected.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+/// @brief Recording of how long each phase of a query takes, written as Chrome trace events
+///
+/// The output can be loaded into chrome://tracing or https://ui.perfetto.dev
+namespace cps::trace {
+
+    namespace fs = std::filesystem;
+
+    namespace detail {
+        /// @brief Set while recording, so that a Span can cheaply tell whether to do anything
+        inline std::atomic<bool> recording{false};
+    } // namespace detail
+
+    /// @brief Whether spans are being recorded
+    inline bool enabled() { return detail::recording.load(std::memory_order_relaxed); }
+
+    /// @brief Start recording spans, to be written to output by finish()
+    void start(fs::path output);
+
+    /// @brief Stop recording, and write the recorded spans
+    ///
+    /// Does nothing if recording was not started. Any spans still open are not written.
+    tl::expected<void, std::string> finish();
+
+    /// @brief A timed region, recorded from construction to destruction
+    ///
+    /// When tracing is not enabled this does nothing besides check a flag, so
+    /// it is cheap enough to leave in hot code. Arguments that are expensive
+    /// to compute should be guarded with active().
+    class Span {
+      public:
+        /// @param name The name of the span, which must outlive it, usually a string literal
+        /// @param category The category of the span, which must outlive it
+        explicit Span(const char * name, const char * category = "cps") : recorded{enabled()} {
+            if (recorded) {
+                begin(name, category);
+            }
+        }
+        ~Span() {
+            if (recorded) {
+                end();
+            }
+        }
+
+        Span(const Span &) = delete;
+        Span & operator=(const Span &) = delete;
+
+        /// @brief Whether this span will be recorded
+        bool active() const { return recorded; }
+
+        /// @brief Attach a value to the span, which is shown alongside it
+        void arg(const char * key, std::string_view value) {
+            if (recorded) {
+                args.emplace_back(key, std::string{value});
+            }
+        }
+        void arg(const char * key, int64_t value) {
+            if (recorded) {
+                args.emplace_back(key, value);
+            }
+        }
+
+        using Arg = std::pair<const char *, std::variant<int64_t, std::string>>;
+
+      private:
+        void begin(const char * name, const char * category);
+        void end();
+
+        const bool recorded;
+        const char * span_name = nullptr;
+        const char * span_category = nullptr;
+        std::chrono::steady_clock::time_point started{};
+        std::vector<Arg> args{};
+    };
+
+} // namespace cps::trace
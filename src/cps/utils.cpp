@@ -5,6 +5,8 @@
 #include "cps/utils.hpp"
 
 #include <algorithm>
+#include <cctype>
+#include <iterator>
 
 #include <fmt/core.h>
 
@@ -23,6 +25,39 @@ namespace cps::utils {
         return out;
     }
 
+    std::vector<std::filesystem::path> split_paths(std::string_view input) {
+        const char * path_sep =
+#ifdef _WIN32
+            ";"
+#else
+            ":"
+#endif
+            ;
+        std::vector<std::string> path_strs = split(input, path_sep);
+        auto result = std::vector<std::filesystem::path>{};
+        std::transform(path_strs.begin(), path_strs.end(), std::back_inserter(result),
+                       [](const std::string & s) { return std::filesystem::path{s}; });
+        return result;
+    }
+
+    std::vector<std::string> split_whitespace(std::string_view input) {
+        const auto is_space = [](unsigned char c) { return std::isspace(c); };
+        std::vector<std::string> out;
+
+        auto it = input.cbegin();
+        while (true) {
+            it = std::find_if_not(it, input.cend(), is_space);
+            if (it == input.cend()) {
+                break;
+            }
+            auto end = std::find_if(it, input.cend(), is_space);
+            out.emplace_back(it, end);
+            it = end;
+        }
+
+        return out;
+    }
+
     std::string_view trim(std::string_view input) {
         const auto is_not_space = [](unsigned char c) { return !std::isspace(c); };
         const size_t prefix_length =
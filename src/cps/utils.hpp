@@ -4,7 +4,9 @@
 
 #pragma once
 
+#include <filesystem>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace cps::utils {
@@ -13,6 +15,12 @@ namespace cps::utils {
 
     std::vector<std::string> split(std::string_view input, std::string_view delim = ":");
 
+    /// @brief Split a list of paths separated like PATH, with ';' on Windows and ':' elsewhere
+    std::vector<std::filesystem::path> split_paths(std::string_view input);
+
+    /// @brief Split a string of arguments on whitespace, dropping empty entries
+    std::vector<std::string> split_whitespace(std::string_view input);
+
     std::string_view trim(std::string_view input);
 
 } // namespace cps::utils
@@ -9,8 +9,10 @@
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <optional>
+#include <string_view>
 
 namespace cps::version {
 
@@ -171,6 +173,110 @@ namespace cps::version {
             return (op == Operator::eq || op == Operator::le || op == Operator::ge);
         }
 
+        bool is_digit(char c) { return c >= '0' && c <= '9'; }
+        bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+        /// @brief Compare two versions as rpmvercmp does, which is also what pkg-config and pkgconf use
+        /// @return Less than, equal to, or greater than 0, as l is older, the same as, or newer than r
+        int rpmvercmp(std::string_view l, std::string_view r) {
+            size_t li = 0;
+            size_t ri = 0;
+            while (li < l.size() || ri < r.size()) {
+                // Anything else only separates segments
+                auto && skip = [](std::string_view s, size_t & i) {
+                    while (i < s.size() && !is_digit(s[i]) && !is_alpha(s[i]) && s[i] != '~' && s[i] != '^') {
+                        ++i;
+                    }
+                };
+                skip(l, li);
+                skip(r, ri);
+                const char lc = li < l.size() ? l[li] : '\0';
+                const char rc = ri < r.size() ? r[ri] : '\0';
+
+                // A '~' sorts before anything, even the end of the version, so 1.0~rc1 < 1.0
+                if (lc == '~' || rc == '~') {
+                    if (lc != '~') {
+                        return 1;
+                    }
+                    if (rc != '~') {
+                        return -1;
+                    }
+                    ++li;
+                    ++ri;
+                    continue;
+                }
+
+                // A '^' sorts after the end of the version, but before anything else, so 1.0 < 1.0^1 < 1.0.1
+                if (lc == '^' || rc == '^') {
+                    if (lc == '\0') {
+                        return -1;
+                    }
+                    if (rc == '\0') {
+                        return 1;
+                    }
+                    if (lc != '^') {
+                        return 1;
+                    }
+                    if (rc != '^') {
+                        return -1;
+                    }
+                    ++li;
+                    ++ri;
+                    continue;
+                }
+
+                if (lc == '\0' || rc == '\0') {
+                    break;
+                }
+
+                // Segments are runs of either digits or letters, whichever the left one starts with
+                const bool numeric = is_digit(lc);
+                auto && segment = [numeric](std::string_view s, size_t & i) {
+                    const size_t start = i;
+                    while (i < s.size() && (numeric ? is_digit(s[i]) : is_alpha(s[i]))) {
+                        ++i;
+                    }
+                    return s.substr(start, i - start);
+                };
+                std::string_view lseg = segment(l, li);
+                std::string_view rseg = segment(r, ri);
+
+                // A number is newer than letters
+                if (rseg.empty()) {
+                    return numeric ? 1 : -1;
+                }
+
+                if (numeric) {
+                    lseg.remove_prefix(std::min(lseg.find_first_not_of('0'), lseg.size()));
+                    rseg.remove_prefix(std::min(rseg.find_first_not_of('0'), rseg.size()));
+                    if (lseg.size() != rseg.size()) {
+                        return lseg.size() > rseg.size() ? 1 : -1;
+                    }
+                }
+                if (const int c = lseg.compare(rseg); c != 0) {
+                    return c < 0 ? -1 : 1;
+                }
+            }
+
+            // Whichever has characters left over is newer
+            if (li >= l.size() && ri >= r.size()) {
+                return 0;
+            }
+            return li < l.size() ? 1 : -1;
+        }
+
+        tl::expected<bool, std::string> rpm_compare(std::string_view l, Operator op, std::string_view r) {
+            switch (compare(rpmvercmp(l, r), op, 0)) {
+            case comp_value::yes:
+                return true;
+            case comp_value::no:
+                return false;
+            case comp_value::unknown:
+                break;
+            }
+            return (op == Operator::eq || op == Operator::le || op == Operator::ge);
+        }
+
     } // namespace
 
     std::string to_string(const Schema schema) {
@@ -192,6 +298,8 @@ namespace cps::version {
         switch (schema) {
         case Schema::simple:
             return simple_compare(left, op, right);
+        case Schema::rpm:
+            return rpm_compare(left, op, right);
         default:
             return tl::unexpected{fmt::format("The {} schema is not implemented", to_string(schema))};
         }
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/config.hpp"
+#include "cps/cps.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cps::capi::test {
+    namespace {
+
+        using Session = std::unique_ptr<cps_session, decltype(&cps_session_free)>;
+        using Result = std::unique_ptr<cps_result, decltype(&cps_result_free)>;
+
+        std::string_view view(cps_string str) { return std::string_view{str.data, str.size}; }
+
+        Session make_session() {
+            Session session{cps_session_new(), cps_session_free};
+            const std::string root = std::string{std::getenv("CPS_TEST_DIR")} + "/cps-files/lib/";
+            cps_session_add_path(session.get(), CPS_PATH_CPS, (root + "cps").c_str());
+            cps_session_add_path(session.get(), CPS_PATH_PC, (root + "pkgconfig").c_str());
+            return session;
+        }
+
+        TEST(CApi, find_package) {
+            auto session = make_session();
+            Result r{cps_find_package(session.get(), "minimal", nullptr, 0, nullptr), cps_result_free};
+            ASSERT_NE(r, nullptr) << cps_session_error(session.get());
+
+            EXPECT_EQ(view(cps_result_version(r.get())), "1.0.0");
+            ASSERT_EQ(cps_result_size(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_C), 2u);
+            EXPECT_EQ(view(cps_result_get(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_C, 0)), "/usr/local/include");
+            EXPECT_EQ(view(cps_result_get(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_C, 1)), "/opt/include");
+            EXPECT_EQ(cps_result_get(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_C, 2).data, nullptr);
+            EXPECT_EQ(cps_result_size(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_FORTRAN), 0u);
+
+            ASSERT_EQ(cps_result_size(r.get(), CPS_FIELD_DEFINITIONS, CPS_LANGUAGE_C), 3u);
+            for (size_t i = 0; i < 3; ++i) {
+                cps_string value{nullptr, 0};
+                const bool has_value = cps_result_definition_value(r.get(), CPS_LANGUAGE_C, i, &value);
+                auto name = view(cps_result_get(r.get(), CPS_FIELD_DEFINITIONS, CPS_LANGUAGE_C, i));
+                if (name == "OTHER") {
+                    EXPECT_FALSE(has_value);
+                } else {
+                    ASSERT_TRUE(has_value) << name;
+                    EXPECT_EQ(view(value), name == "FOO" ? "1" : "2");
+                }
+            }
+        }
+
+        TEST(CApi, components) {
+            auto session = make_session();
+            const char * components[] = {"sample0"};
+            Result r{cps_find_package(session.get(), "minimal", components, 1, nullptr), cps_result_free};
+            ASSERT_NE(r, nullptr) << cps_session_error(session.get());
+            ASSERT_EQ(cps_result_size(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_C), 1u);
+            EXPECT_EQ(view(cps_result_get(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_C, 0)), "/err");
+        }
+
+        TEST(CApi, link_flags) {
+            auto session = make_session();
+            Result r{cps_find_package(session.get(), "pc-variables", nullptr, 0, nullptr), cps_result_free};
+            ASSERT_NE(r, nullptr) << cps_session_error(session.get());
+            ASSERT_EQ(cps_result_size(r.get(), CPS_FIELD_LINK_FLAGS, CPS_LANGUAGE_C), 2u);
+            EXPECT_EQ(cps_result_link_flag_type(r.get(), 0), CPS_LINK_FLAG_SEARCH_DIR);
+            EXPECT_EQ(view(cps_result_get(r.get(), CPS_FIELD_LINK_FLAGS, CPS_LANGUAGE_C, 0)), "/home/kaniini/pkg/lib");
+            EXPECT_EQ(cps_result_link_flag_type(r.get(), 1), CPS_LINK_FLAG_LIBRARY);
+            EXPECT_EQ(view(cps_result_get(r.get(), CPS_FIELD_LINK_FLAGS, CPS_LANGUAGE_C, 1)), "foo");
+        }
+
+        TEST(CApi, configured_system_includes) {
+            // The first directory set when cps-config was built, or else the include directory of /usr
+            std::string_view configured{CPS_CONFIG_SYSTEM_INCLUDE_PATH};
+#ifdef _WIN32
+            const char path_sep = ';';
+#else
+            const char path_sep = ':';
+#endif
+            const std::string system_include =
+                configured.empty() ? "/usr/include" : std::string{configured.substr(0, configured.find(path_sep))};
+
+            auto session = make_session();
+            Result r{cps_find_package(session.get(), "system-include", nullptr, 0, system_include.c_str()),
+                     cps_result_free};
+            ASSERT_NE(r, nullptr) << cps_session_error(session.get());
+            ASSERT_EQ(cps_result_size(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_C), 1u);
+            EXPECT_EQ(view(cps_result_get(r.get(), CPS_FIELD_INCLUDES, CPS_LANGUAGE_C, 0)), "/opt/include");
+        }
+
+        TEST(CApi, not_found) {
+            auto session = make_session();
+            EXPECT_EQ(cps_session_error(session.get()), nullptr);
+            Result r{cps_find_package(session.get(), "does-not-exist", nullptr, 0, nullptr), cps_result_free};
+            ASSERT_EQ(r, nullptr);
+            EXPECT_EQ(std::string_view{cps_session_error(session.get())}, "Could not find a CPS file for does-not-exist");
+        }
+
+        TEST(CApi, sessions_have_separate_paths) {
+            auto with_paths = make_session();
+            Result found{cps_find_package(with_paths.get(), "minimal", nullptr, 0, nullptr), cps_result_free};
+            ASSERT_NE(found, nullptr) << cps_session_error(with_paths.get());
+
+            Session without_paths{cps_session_new(), cps_session_free};
+            Result not_found{cps_find_package(without_paths.get(), "minimal", nullptr, 0, nullptr), cps_result_free};
+            EXPECT_EQ(not_found, nullptr);
+        }
+
+        TEST(CApi, concurrent_sessions) {
+            std::vector<std::thread> threads;
+            std::vector<int> found(8, 0);
+            for (size_t i = 0; i < found.size(); ++i) {
+                threads.emplace_back([&found, i]() {
+                    auto session = make_session();
+                    for (int j = 0; j < 50; ++j) {
+                        Result r{cps_find_package(session.get(), j % 2 ? "minimal" : "diamond", nullptr, 0, nullptr),
+                                 cps_result_free};
+                        found[i] += r != nullptr;
+                    }
+                });
+            }
+            for (auto && t : threads) {
+                t.join();
+            }
+            for (auto && f : found) {
+                EXPECT_EQ(f, 50);
+            }
+        }
+
+    } // namespace
+} // namespace cps::capi::test
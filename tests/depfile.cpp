@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/depfile.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace cps::depfile::test {
+    namespace {
+
+        TEST(Depfile, escape) {
+            EXPECT_EQ(escape("/usr/lib/cps/foo.cps"), "/usr/lib/cps/foo.cps");
+            EXPECT_EQ(escape("/a b/#c/$d"), "/a\\ b/\\#c/$$d");
+            EXPECT_EQ(escape("C:/cps/foo.cps"), "C\\:/cps/foo.cps");
+        }
+
+        TEST(Depfile, rule) {
+            EXPECT_EQ(rule("out.d", {}), "out.d:\n");
+            EXPECT_EQ(rule("C:/build/flags.txt", {"C:/cps/foo.cps", "/usr/lib/pkgconfig/a b.pc"}),
+                      "C\\:/build/flags.txt: \\\n  C\\:/cps/foo.cps \\\n  /usr/lib/pkgconfig/a\\ b.pc\n");
+        }
+
+        TEST(Depfile, write) {
+            const fs::path path = fs::temp_directory_path() / "cps-config-test.d";
+            ASSERT_TRUE(write(path, "flags.txt", {"/cps/foo.cps"}));
+            std::ifstream in{path};
+            const std::string text{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+            in.close();
+            fs::remove(path);
+            EXPECT_EQ(text, "flags.txt: \\\n  /cps/foo.cps\n");
+        }
+
+    } // namespace
+} // namespace cps::depfile::test
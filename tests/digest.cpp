@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/digest.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace cps::digest::test {
+    namespace {
+
+        // The examples from FIPS 180-4
+        TEST(Sha256, empty) {
+            EXPECT_EQ(sha256(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        }
+
+        TEST(Sha256, one_block) {
+            EXPECT_EQ(sha256("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        }
+
+        TEST(Sha256, two_blocks) {
+            EXPECT_EQ(sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+                      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+        }
+
+        TEST(Sha256, incremental) {
+            Sha256 h{};
+            const std::string chunk(1000, 'a');
+            for (int i = 0; i < 1000; ++i) {
+                h.update(chunk);
+            }
+            EXPECT_EQ(h.hex(), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+        }
+
+        TEST(Sha256, fields) {
+            Sha256 a{};
+            a.field("ab");
+            a.field("c");
+            Sha256 b{};
+            b.field("a");
+            b.field("bc");
+            EXPECT_NE(a.hex(), b.hex());
+        }
+
+    } // namespace
+} // namespace cps::digest::test
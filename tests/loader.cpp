@@ -8,6 +8,7 @@
 #include <sstream>
 
 using namespace std::string_literals;
+namespace fs = std::filesystem;
 
 namespace cps::utils::test {
     namespace {
@@ -249,7 +250,7 @@ namespace cps::utils::test {
 )"s);
             auto const package = cps::loader::load(ss, "valid_component_types");
             ASSERT_TRUE(package.has_value()) << "should have parsed, found error: " << package.error();
-            ASSERT_EQ(package->components.size(), 7) << "should have found 7 different components";
+            ASSERT_EQ(package->components.size(), 7u) << "should have found 7 different components";
         }
 
         TEST(Loader, valid_component_type_extension) {
@@ -327,5 +328,58 @@ namespace cps::utils::test {
                                               << "actual error:" << package.error();
         }
 
+        TEST(Loader, link_flags_are_categorized) {
+            std::stringstream ss(R"({
+    "name": "link_flags_are_categorized",
+    "cps_version": "0.13.0",
+    "prefix": "/sentinel/",
+    "components": {
+        "default": {
+            "type": "interface",
+            "link_flags": ["-L/usr/lib", "-lfoo", "-flto", "-framework", "Cocoa", "-L", "/opt/lib", "-l"]
+        }
+    }
+}
+)"s);
+            auto const package = cps::loader::load(ss, "link_flags_are_categorized");
+            ASSERT_TRUE(package.has_value()) << "should have parsed, found error: " << package.error();
+
+            const std::vector<loader::LinkFlag> & flags = package->components.at("default").link_flags;
+            const std::vector<std::pair<loader::LinkFlagType, std::string>> expected{
+                {loader::LinkFlagType::search_dir, "/usr/lib"}, {loader::LinkFlagType::library, "foo"},
+                {loader::LinkFlagType::other, "-flto"},         {loader::LinkFlagType::framework, "Cocoa"},
+                {loader::LinkFlagType::search_dir, "/opt/lib"}, {loader::LinkFlagType::other, "-l"},
+            };
+            ASSERT_EQ(flags.size(), expected.size());
+            for (size_t i = 0; i < flags.size(); ++i) {
+                EXPECT_EQ(flags[i].type, expected[i].first) << "for flag " << i;
+                EXPECT_EQ(flags[i].value, expected[i].second) << "for flag " << i;
+            }
+        }
+
+        TEST(PrefixPath, relative_to_prefix) {
+            EXPECT_TRUE(loader::PrefixPath{"@prefix@"}.relative_to_prefix());
+            EXPECT_TRUE(loader::PrefixPath{"@prefix@/include"}.relative_to_prefix());
+            EXPECT_FALSE(loader::PrefixPath{"/usr/include"}.relative_to_prefix());
+            EXPECT_FALSE(loader::PrefixPath{"@prefix@include"}.relative_to_prefix());
+            EXPECT_FALSE(loader::PrefixPath{"include/@prefix@"}.relative_to_prefix());
+        }
+
+        TEST(PrefixPath, resolve) {
+            const fs::path prefix{"/opt/foo"};
+            EXPECT_EQ(loader::PrefixPath{"@prefix@/include"}.resolve(prefix), fs::path{"/opt/foo/include"});
+            EXPECT_EQ(loader::PrefixPath{"@prefix@//lib/libfoo.a"}.resolve(prefix), fs::path{"/opt/foo/lib/libfoo.a"});
+            EXPECT_EQ(loader::PrefixPath{"@prefix@"}.resolve(prefix), prefix);
+            EXPECT_EQ(loader::PrefixPath{"/usr/include"}.resolve(prefix), fs::path{"/usr/include"});
+            EXPECT_EQ(loader::PrefixPath{"@prefix@include"}.resolve(prefix), fs::path{"@prefix@include"});
+        }
+
+        TEST(PrefixPath, resolve_like_joining) {
+            // The same as joining the paths with `/`
+            EXPECT_EQ(loader::PrefixPath{"@prefix@/include"}.resolve("/opt/foo/"), fs::path{"/opt/foo/include"});
+            EXPECT_EQ(loader::PrefixPath{"@prefix@/include"}.resolve("/"), fs::path{"/include"});
+            EXPECT_EQ(loader::PrefixPath{"@prefix@/include"}.resolve(""), fs::path{"include"});
+        }
+
     } // unnamed namespace
 } // namespace cps::utils::test
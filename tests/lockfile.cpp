@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/lockfile.hpp"
+
+#include "render.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace cps::lockfile::test {
+    namespace {
+
+        /// @brief A copy of the test packages, which tests may change, and a lockfile to write
+        class Lock : public ::testing::Test {
+          protected:
+            void SetUp() override {
+                dir = fs::temp_directory_path() /
+                      (::testing::UnitTest::GetInstance()->current_test_info()->name() + std::string{".lock.d"});
+                fs::remove_all(dir);
+                fs::copy(std::string{std::getenv("CPS_TEST_DIR")} + "/cps-files/lib", dir,
+                         fs::copy_options::recursive);
+                output = dir / "cps.lock";
+            }
+            void TearDown() override {
+                std::error_code ec;
+                fs::remove_all(dir, ec);
+            }
+
+            Env env() const {
+                return Env{.cps_path = std::vector<fs::path>{dir / "cps"},
+                           .pc_path = std::vector<fs::path>{dir / "pkgconfig"},
+                           .digests = true};
+            }
+
+            /// @brief Lock the default components of packages
+            void lock(const std::vector<std::string> & names) {
+                search::Session session{env()};
+                std::vector<search::Query> queries;
+                std::vector<search::Result> results;
+                for (auto && name : names) {
+                    auto && result = search::find_package(session, name, {}, true, std::nullopt);
+                    ASSERT_TRUE(result) << result.error();
+                    queries.emplace_back(search::Query{name});
+                    results.emplace_back(std::move(result.value()));
+                }
+                ASSERT_TRUE(write(output, session, queries, results));
+            }
+
+            fs::path dir;
+            fs::path output;
+        };
+
+        /// @brief Prints all of the flags of a result, for every language
+        const printer::Config all_flags{.defines = true,
+                                        .includes = true,
+                                        .cflags = true,
+                                        .libs_link = true,
+                                        .libs_search = true,
+                                        .libs_other = true,
+                                        .languages = {loader::KnownLanguages::c, loader::KnownLanguages::cxx,
+                                                      loader::KnownLanguages::fortran}};
+
+        TEST_F(Lock, same_flags) {
+            const std::vector<std::string> names{"diamond", "multiple-components", "declaration-order",
+                                                 "pc-variables"};
+            lock(names);
+            auto && read_lock = read(output);
+            ASSERT_TRUE(read_lock) << read_lock.error();
+            EXPECT_EQ(read_lock->files.size(), 7u);
+
+            for (auto && name : names) {
+                search::Session session{env()};
+                auto && searched = search::find_package(session, name, {}, true, std::nullopt);
+                ASSERT_TRUE(searched);
+                auto && locked = find(read_lock.value(), search::Query{name}, session);
+                ASSERT_TRUE(locked) << locked.error();
+                EXPECT_EQ(locked->version, searched->version);
+                EXPECT_EQ(cps::test::render(locked.value(), all_flags), cps::test::render(searched.value(), all_flags))
+                    << name;
+                EXPECT_EQ(locked->digest(), searched->digest()) << name;
+
+                // Repeated arguments are kept in the lockfile
+                searched->deduplicate = false;
+                locked->deduplicate = false;
+                EXPECT_EQ(cps::test::render(locked.value(), all_flags), cps::test::render(searched.value(), all_flags))
+                    << name;
+            }
+        }
+
+        TEST_F(Lock, not_locked) {
+            lock({"minimal"});
+            auto && read_lock = read(output);
+            ASSERT_TRUE(read_lock) << read_lock.error();
+            const search::Session session{env()};
+            EXPECT_TRUE(find(read_lock.value(), search::Query{"minimal"}, session));
+
+            auto && missing = find(read_lock.value(), search::Query{"diamond"}, session);
+            ASSERT_FALSE(missing);
+            EXPECT_EQ(missing.error(), "diamond is not locked");
+            missing = find(read_lock.value(), search::Query{"minimal", {"sample3"}, false}, session);
+            ASSERT_FALSE(missing);
+            EXPECT_EQ(missing.error(), "minimal with components sample3 is not locked");
+        }
+
+        TEST_F(Lock, system_dirs) {
+            lock({"minimal"});
+            auto && read_lock = read(output);
+            ASSERT_TRUE(read_lock) << read_lock.error();
+
+            Env keep = env();
+            keep.keep_system_libs = true;
+            auto && kept = find(read_lock.value(), search::Query{"minimal"}, search::Session{keep});
+            ASSERT_FALSE(kept);
+            EXPECT_EQ(kept.error(), "it was written with different system directories");
+
+            Env other = env();
+            other.system_include_path = std::vector<fs::path>{"/opt/include"};
+            EXPECT_FALSE(find(read_lock.value(), search::Query{"minimal"}, search::Session{other}));
+        }
+
+        TEST_F(Lock, changed) {
+            lock({"minimal"});
+            std::ofstream{dir / "cps" / "minimal.cps", std::ios::app} << '\n';
+            auto && read_lock = read(output);
+            ASSERT_FALSE(read_lock);
+            EXPECT_EQ(read_lock.error(), (dir / "cps" / "minimal.cps").generic_string() +
+                                             " has changed since lockfile " + output.string() + " was written");
+        }
+
+    } // namespace
+} // namespace cps::lockfile::test
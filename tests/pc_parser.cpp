@@ -83,5 +83,23 @@ namespace cps::utils::test {
                 pc_loader.properties["Requires"],
                 {PackageRequirement{.package = "libbar", .operation = VersionOperation::gt, .version = "2.0.0"}});
         }
+        TEST(PcLoader, flags_are_categorized) {
+            PcLoader pc_loader;
+            fs::path file_path = "/cps-files/lib/pkgconfig/pc-variables.pc";
+            std::ifstream input = open_pc_test_file(file_path);
+            auto && package = pc_loader.load(input, file_path.parent_path());
+            ASSERT_TRUE(package.has_value()) << package.error();
+
+            const loader::Component & comp = package->components.at("libfoo");
+            ASSERT_EQ(comp.includes.at(loader::KnownLanguages::c),
+                      std::vector{loader::PrefixPath{"/home/kaniini/pkg/include/libfoo"}});
+            ASSERT_TRUE(comp.compile_flags.at(loader::KnownLanguages::c).empty());
+
+            ASSERT_EQ(comp.link_flags.size(), 2u);
+            ASSERT_EQ(comp.link_flags[0].type, loader::LinkFlagType::search_dir);
+            ASSERT_EQ(comp.link_flags[0].value, "/home/kaniini/pkg/lib");
+            ASSERT_EQ(comp.link_flags[1].type, loader::LinkFlagType::library);
+            ASSERT_EQ(comp.link_flags[1].value, "foo");
+        }
     } // namespace
 } // namespace cps::utils::test
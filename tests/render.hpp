@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#pragma once
+
+#include "cps/printer.hpp"
+#include "cps/search.hpp"
+
+#include <cstdio>
+#include <string>
+
+namespace cps::test {
+
+    /// @brief Print a result as cps-config does, and return the text
+    inline std::string render(const search::Result & result, const printer::Config & conf) {
+        std::FILE * out = std::tmpfile();
+        printer::pkgconf(result, conf, out);
+        std::rewind(out);
+        std::string text;
+        char buf[256];
+        while (size_t n = std::fread(buf, 1, sizeof(buf), out)) {
+            text.append(buf, n);
+        }
+        std::fclose(out);
+        return text;
+    }
+
+} // namespace cps::test
@@ -9,6 +9,7 @@ import asyncio
 import contextlib
 import dataclasses
 import enum
+import json
 import pathlib
 import os
 import re
@@ -30,12 +31,16 @@ if typing.TYPE_CHECKING:
     class TestCase(typing.TypedDict):
 
         name: str
-        cps: str
+        cps: typing.NotRequired[str]
         args: list[str]
         expected: str
-        mode: typing.NotRequired[typing.Literal['pkgconf']]
+        stdin: typing.NotRequired[str]
+        env: typing.NotRequired[dict[str, str]]
+        mode: typing.NotRequired[typing.Literal['pkgconf', 'json', 'jsonl']]
         returncode: typing.NotRequired[int]
         re: typing.NotRequired[bool]
+        setup: typing.NotRequired[list[list[str]]]
+        stderr: typing.NotRequired[str]
 
     class TestDescription(typing.TypedDict):
 
@@ -72,13 +77,29 @@ def unordered_compare(out: str, expected: str) -> bool:
     return sorted(out_parts) == sorted(expected_parts)
 
 
-def is_success(rt: int, case_: TestCase, out: str, expected: str) -> bool:
+def is_success(rt: int, case_: TestCase, out: str, err: str, expected: str) -> bool:
     if rt != case_.get('returncode', 0):
         return False
 
+    if 'stderr' in case_ and re.search(case_['stderr'], err) is None:
+        return False
+
     if case_.get('re', False):
         return re.search(expected, out) is not None
 
+    if case_.get('mode') == 'json':
+        try:
+            return json.loads(out) == json.loads(expected)
+        except json.JSONDecodeError:
+            return False
+
+    if case_.get('mode') == 'jsonl':
+        try:
+            return ([json.loads(l) for l in out.splitlines()] ==
+                    [json.loads(l) for l in expected.splitlines()])
+        except json.JSONDecodeError:
+            return False
+
     if out == expected:
         return True
 
@@ -86,28 +107,59 @@ def is_success(rt: int, case_: TestCase, out: str, expected: str) -> bool:
 
 
 async def test(args: Arguments, case_: TestCase) -> Result:
+    with tempfile.TemporaryDirectory() as tmpdir:
+        return await _test(args, case_, pathlib.Path(tmpdir).as_posix())
+
+
+async def _test(args: Arguments, case_: TestCase, tmpdir: str) -> Result:
     prefix = args.prefix or SOURCE_DIR
     prefix = pathlib.Path(prefix).as_posix()
 
-    cmd = [args.runner] + case_['args']
-    cmd.append(case_['cps'].replace('{prefix}', os.path.join(prefix, args.libdir, 'cps')))
-    if 'mode' in case_:
+    # Each case has its own temporary directory, for files written by the
+    # setup commands, which run in order before the case itself
+    setup = [[args.runner] + [a.replace('{tmpdir}', tmpdir) for a in s] for s in case_.get('setup', [])]
+    cmd = [args.runner] + [a.replace('{tmpdir}', tmpdir) for a in case_['args']]
+    if 'cps' in case_:
+        cmd.append(case_['cps'].replace('{prefix}', os.path.join(prefix, args.libdir, 'cps')))
+    # jsonl is only produced by batch mode, which has no --format
+    if 'mode' in case_ and case_['mode'] != 'jsonl':
         cmd.extend([f"--format={case_['mode']}"])
 
-    expected = case_['expected'].format(prefix=prefix, libdir=args.libdir)
+    # Not using str.format, as json expectations are full of braces
+    expected = case_['expected'].replace('{prefix}', prefix).replace('{libdir}', args.libdir)
+    stdin = case_.get('stdin')
+    env = dict(os.environ, **case_.get('env', {}))
 
     try:
         async with asyncio.timeout(5):
-            proc = await asyncio.create_subprocess_exec(
-                *cmd,
-                stdout=asyncio.subprocess.PIPE,
-                stderr=asyncio.subprocess.PIPE,
-            )
-        bout, berr = await proc.communicate()
+            # A setup command which fails is reported in place of the case
+            setup_failed = False
+            for s in setup:
+                proc = await asyncio.create_subprocess_exec(
+                    *s,
+                    stdout=asyncio.subprocess.PIPE,
+                    stderr=asyncio.subprocess.PIPE,
+                    env=env,
+                )
+                bout, berr = await proc.communicate()
+                if proc.returncode != 0:
+                    setup_failed = True
+                    cmd = s
+                    break
+            if not setup_failed:
+                proc = await asyncio.create_subprocess_exec(
+                    *cmd,
+                    stdin=asyncio.subprocess.PIPE if stdin is not None else None,
+                    stdout=asyncio.subprocess.PIPE,
+                    stderr=asyncio.subprocess.PIPE,
+                    env=env,
+                )
+        if not setup_failed:
+            bout, berr = await proc.communicate(stdin.encode() if stdin is not None else None)
         out = bout.decode().strip()
         err = berr.decode().strip()
 
-        success = is_success(proc.returncode, case_, out, expected)
+        success = not setup_failed and is_success(proc.returncode, case_, out, err, expected)
         result = Status.PASS if success else Status.FAIL
         returncode = proc.returncode
     except asyncio.TimeoutError:
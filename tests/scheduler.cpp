@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <functional>
+
+namespace cps::scheduler::test {
+    namespace {
+
+        TEST(Pool, runs_all_tasks) {
+            std::atomic<int> count{0};
+            Pool pool{4};
+            for (int i = 0; i < 1000; ++i) {
+                pool.submit([&count]() { ++count; });
+            }
+            pool.wait();
+            EXPECT_EQ(count.load(), 1000);
+        }
+
+        TEST(Pool, waits_for_subtasks) {
+            std::atomic<int> count{0};
+            Pool pool{4};
+            // A binary tree of tasks, 10 levels deep
+            std::function<void(int)> spawn = [&](int depth) {
+                ++count;
+                if (depth == 0) {
+                    return;
+                }
+                Pool * current = Pool::current();
+                ASSERT_EQ(current, &pool);
+                current->submit([&spawn, depth]() { spawn(depth - 1); });
+                current->submit([&spawn, depth]() { spawn(depth - 1); });
+            };
+            pool.submit([&spawn]() { spawn(10); });
+            pool.wait();
+            EXPECT_EQ(count.load(), (1 << 11) - 1);
+        }
+
+        TEST(Pool, reusable_after_wait) {
+            std::atomic<int> count{0};
+            Pool pool{2};
+            for (int round = 1; round <= 3; ++round) {
+                for (int i = 0; i < 10; ++i) {
+                    pool.submit([&count]() { ++count; });
+                }
+                pool.wait();
+                EXPECT_EQ(count.load(), round * 10);
+            }
+        }
+
+        TEST(Pool, single_thread) {
+            int count = 0;
+            Pool pool{1};
+            std::function<void(int)> spawn = [&](int depth) {
+                ++count;
+                if (depth > 0) {
+                    Pool::current()->submit([&spawn, depth]() { spawn(depth - 1); });
+                }
+            };
+            pool.submit([&spawn]() { spawn(100); });
+            pool.wait();
+            EXPECT_EQ(count, 101);
+        }
+
+        TEST(Pool, current_outside_pool) { EXPECT_EQ(Pool::current(), nullptr); }
+
+    } // namespace
+} // namespace cps::scheduler::test
@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/search.hpp"
+
+#include "render.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cps::search::test {
+    namespace {
+
+        std::string test_root() { return std::string{std::getenv("CPS_TEST_DIR")} + "/cps-files/lib/"; }
+
+        Session make_session(bool digests = false) {
+            const std::string root = test_root();
+            return Session{Env{.cps_path = std::vector<fs::path>{root + "cps"},
+                               .pc_path = std::vector<fs::path>{root + "pkgconfig"},
+                               .digests = digests}};
+        }
+
+        TEST(Stats, cached) {
+            auto session = make_session();
+            ASSERT_TRUE(find_package(session, "minimal", {}, true, std::nullopt));
+            ASSERT_TRUE(find_package(session, "minimal", {}, true, std::nullopt));
+
+            const Stats & stats = session.stats();
+            EXPECT_EQ(stats.cps_files_parsed, 1u);
+            EXPECT_EQ(stats.pc_files_parsed, 0u);
+            EXPECT_EQ(stats.open_calls, 1u);
+            EXPECT_GT(stats.bytes_read, 0u);
+            EXPECT_EQ(stats.path_cache_misses, 1u);
+            EXPECT_EQ(stats.path_cache_hits, 1u);
+            EXPECT_EQ(stats.package_cache_misses, 1u);
+            EXPECT_EQ(stats.package_cache_hits, 1u);
+            // Nodes are created for each query
+            EXPECT_EQ(stats.graph_nodes, 2u);
+            EXPECT_EQ(stats.graph_edges, 0u);
+        }
+
+        TEST(Stats, graph) {
+            auto session = make_session();
+            ASSERT_TRUE(find_package(session, "pc-variables", {}, true, std::nullopt));
+            ASSERT_TRUE(find_package(session, "diamond", {}, true, std::nullopt));
+
+            const Stats & stats = session.stats();
+            EXPECT_EQ(stats.pc_files_parsed, 1u);
+            // diamond requires two packages, which both require
+            // multiple-components, which requires minimal. Both sides of the
+            // diamond share a node for each package
+            EXPECT_EQ(stats.graph_nodes, 6u);
+            EXPECT_EQ(stats.graph_edges, 5u);
+        }
+
+        TEST(Stats, diamond_shares_nodes) {
+            auto session = make_session();
+            auto && result = find_package(session, "diamond", {}, true, std::nullopt);
+            ASSERT_TRUE(result) << result.error();
+            EXPECT_EQ(session.stats().graph_nodes, 5u);
+
+            // Each side of the diamond uses a different component of
+            // multiple-components, and both require minimal. Every component
+            // is in the result once
+            std::vector<const loader::Component *> shared;
+            std::set<const loader::Component *> components;
+            for (auto && e : result->entries) {
+                if (e.package->name == "multiple-components") {
+                    shared.emplace_back(e.component);
+                }
+                components.emplace(e.component);
+            }
+            EXPECT_EQ(shared.size(), 2u);
+            EXPECT_EQ(components.size(), result->entries.size());
+        }
+
+        TEST(Stats, rejected) {
+            auto session = make_session();
+            EXPECT_FALSE(find_package(session, "needs-version", {}, true, std::nullopt));
+            EXPECT_FALSE(find_package(session, "minimal", {"does-not-exist"}, false, std::nullopt));
+
+            const Stats & stats = session.stats();
+            EXPECT_EQ(stats.rejected_version, 1u);
+            EXPECT_EQ(stats.rejected_requires, 1u);
+            EXPECT_EQ(stats.rejected_components, 1u);
+        }
+
+        TEST(Stats, format) {
+            auto session = make_session();
+            ASSERT_TRUE(find_package(session, "minimal", {}, true, std::nullopt));
+            const std::string out = to_string(session.stats());
+            EXPECT_NE(out.find("cps files parsed: 1\n"), std::string::npos);
+            EXPECT_NE(out.find("package cache misses: 1\n"), std::string::npos);
+        }
+
+        Result make_result(const std::string & prefix) {
+            auto package = std::make_shared<loader::Package>();
+            loader::Component comp{};
+            comp.type = loader::Type::archive;
+            comp.location = loader::PrefixPath{"@prefix@/lib/libfoo.a"};
+            comp.includes[loader::KnownLanguages::c].emplace_back("@prefix@/include");
+            comp.link_flags = loader::parse_link_flags({"-L/usr/lib", "-lz", "-Wl,--as-needed"});
+            auto && stored = package->components.emplace("default", std::move(comp)).first->second;
+
+            Result r{};
+            r.prefixes.emplace_back(prefix);
+            r.entries.emplace_back(
+                Result::Entry{.package = std::move(package), .component = &stored, .prefix = 0, .link_only = false});
+            return r;
+        }
+
+        TEST(Result, merge_keeps_prefixes) {
+            Result r = make_result("/a");
+            r.merge(make_result("/b"));
+            ASSERT_EQ(r.entries.size(), 2u);
+
+            std::vector<fs::path> includes;
+            r.for_each_compile(&loader::Component::includes, loader::KnownLanguages::c,
+                               [&](const loader::PrefixPath & p, const Result::Entry & e) {
+                                   includes.emplace_back(p.resolve(r.prefix(e)));
+                               });
+            EXPECT_EQ(includes, (std::vector<fs::path>{"/a/include", "/b/include"}));
+            EXPECT_EQ(r.entries[1].location()->resolve(r.prefix(r.entries[1])), fs::path{"/b/lib/libfoo.a"});
+        }
+
+        TEST(Result, link_only) {
+            Result r = make_result("/a");
+            r.entries[0].link_only = true;
+            size_t includes = 0;
+            r.for_each_compile(&loader::Component::includes, loader::KnownLanguages::c,
+                               [&](auto &&, auto &&) { ++includes; });
+            EXPECT_EQ(includes, 0u);
+            EXPECT_NE(r.entries[0].location(), nullptr);
+        }
+
+        TEST(Result, deduplicate) {
+            Result r = make_result("/a");
+            r.merge(make_result("/b"));
+            r.merge(make_result("/a"));
+
+            auto includes = [&r]() {
+                std::vector<fs::path> paths;
+                r.for_each_compile(&loader::Component::includes, loader::KnownLanguages::c,
+                                   [&](const loader::PrefixPath & p, const Result::Entry & e) {
+                                       paths.emplace_back(p.resolve(r.prefix(e)));
+                                   });
+                return paths;
+            };
+            EXPECT_EQ(includes(), (std::vector<fs::path>{"/a/include", "/b/include"}));
+
+            r.deduplicate = false;
+            EXPECT_EQ(includes(), (std::vector<fs::path>{"/a/include", "/b/include", "/a/include"}));
+        }
+
+        TEST(Result, deduplicate_flag_arguments) {
+            auto package = std::make_shared<loader::Package>();
+            auto && add = [&](const std::string & name, std::vector<std::string> flags) -> const loader::Component * {
+                loader::Component comp{};
+                comp.type = loader::Type::interface;
+                comp.compile_flags[loader::KnownLanguages::c] = std::move(flags);
+                return &package->components.emplace(name, std::move(comp)).first->second;
+            };
+            const loader::Component * first = add("first", {"-isystem", "/opt/a", "-include", "x.h", "-fPIC"});
+            const loader::Component * second = add("second", {"-isystem", "/opt/b", "-include", "y.h", "-fPIC"});
+
+            Result r{};
+            r.prefixes.emplace_back("/");
+            for (auto && comp : {first, second}) {
+                r.entries.emplace_back(
+                    Result::Entry{.package = package, .component = comp, .prefix = 0, .link_only = false});
+            }
+
+            std::vector<std::string> flags;
+            r.for_each_compile(&loader::Component::compile_flags, loader::KnownLanguages::c,
+                               [&](const std::string & f, auto &&) { flags.emplace_back(f); });
+            EXPECT_EQ(flags, (std::vector<std::string>{"-isystem", "/opt/a", "-include", "x.h", "-isystem", "/opt/b",
+                                                       "-include", "y.h", "-fPIC"}));
+        }
+
+        TEST(Result, compact_link_line) {
+            Result r = make_result("/a");
+            r.merge(make_result("/b"));
+            r.merge(make_result("/a"));
+
+            std::vector<std::string> flags;
+            r.for_each_link(&loader::Component::link_flags,
+                            [&](const loader::LinkFlag & f, auto &&) { flags.emplace_back(f.value); });
+            EXPECT_EQ(flags, (std::vector<std::string>{"/usr/lib", "-Wl,--as-needed", "-Wl,--as-needed", "z",
+                                                       "-Wl,--as-needed"}));
+
+            std::vector<fs::path> locations;
+            r.for_each_location([&](const loader::PrefixPath & l, const Result::Entry & e) {
+                locations.emplace_back(l.resolve(r.prefix(e)));
+            });
+            EXPECT_EQ(locations, (std::vector<fs::path>{"/b/lib/libfoo.a", "/a/lib/libfoo.a"}));
+        }
+
+        /// @brief Print all of the flags of a package, as cps-config does, using a new Session
+        std::string render(std::string_view name) {
+            auto session = make_session();
+            auto && result = find_package(session, name, {}, true, std::nullopt);
+            if (!result) {
+                return result.error();
+            }
+
+            return cps::test::render(result.value(), printer::Config{.defines = true,
+                                                                     .includes = true,
+                                                                     .cflags = true,
+                                                                     .libs_link = true,
+                                                                     .libs_search = true,
+                                                                     .libs_other = true});
+        }
+
+        TEST(Result, declaration_order) {
+            // The components, definitions and requirements of each package
+            // are all used in the order they are declared in, not the order
+            // they are stored in
+            EXPECT_EQ(render("declaration-order"),
+                      "-fzeta -falpha -fopenmp -I/opt/order/include/alpha -I/opt/include -I/something -DZ=1 -DA=2 -DM "
+                      "-DFOO=1 -l/something/lib/libfoo.so.1.2.0 -l/something/lib/libfoo.so -ldl -lrt\n");
+        }
+
+        TEST(Result, digest) {
+            auto digest = [](std::string_view name, const std::vector<std::string> & components = {}) {
+                auto session = make_session(true);
+                auto && result = find_package(session, name, components, components.empty(), std::nullopt);
+                EXPECT_TRUE(result);
+                return result->digest();
+            };
+
+            const std::string minimal = digest("minimal");
+            EXPECT_EQ(minimal.size(), 64u);
+            EXPECT_EQ(minimal, digest("minimal"));
+            EXPECT_NE(minimal, digest("diamond"));
+            EXPECT_NE(digest("multiple-components", {"sample1"}), digest("multiple-components", {"sample2"}));
+
+            auto session = make_session(true);
+            auto && result = find_package(session, "minimal", {}, true, std::nullopt);
+            ASSERT_TRUE(result);
+            result->deduplicate = false;
+            EXPECT_NE(result->digest(), minimal);
+        }
+
+        TEST(Result, digest_only_when_asked) {
+            for (bool digests : {false, true}) {
+                auto session = make_session(digests);
+                auto && result = find_package(session, "diamond", {}, true, std::nullopt);
+                ASSERT_TRUE(result);
+                for (auto && e : result->entries) {
+                    EXPECT_EQ(e.package->digest.size(), digests ? 64u : 0u) << e.package->name;
+                }
+            }
+        }
+
+        TEST(Probe, follow_requires) {
+            auto session = make_session();
+            auto && found = probe_package(session, "diamond", {}, true);
+            ASSERT_TRUE(found) << found.error();
+            EXPECT_EQ(found.value()->name, "diamond");
+            EXPECT_EQ(session.stats().cps_files_parsed, 5u);
+        }
+
+        TEST(Probe, root_only) {
+            auto session = make_session();
+            auto && found = probe_package(session, "diamond", {}, false);
+            ASSERT_TRUE(found) << found.error();
+            EXPECT_EQ(found.value()->name, "diamond");
+            EXPECT_EQ(session.stats().cps_files_parsed, 1u);
+            EXPECT_EQ(session.stats().graph_edges, 0u);
+
+            // The requirements of needs-version cannot be satisfied
+            EXPECT_TRUE(probe_package(session, "needs-version", {}, false));
+            EXPECT_FALSE(probe_package(session, "needs-version", {}, true));
+        }
+
+        TEST(Errors, nested) {
+            auto session = make_session();
+            auto && result = find_package(session, "needs-version", {}, true, std::nullopt);
+            ASSERT_FALSE(result);
+            EXPECT_EQ(result.error(), "needs-version:\n"
+                                      "  multiple-components:\n"
+                                      "  Tried " +
+                                          test_root() +
+                                          "cps/multiple-components.cps, which does not specify a version or "
+                                          "compat_version, but the user requires version 1.0");
+        }
+
+        TEST(Errors, components) {
+            auto session = make_session();
+            auto && result = find_package(session, "minimal", {"a", "b"}, false, std::nullopt);
+            ASSERT_FALSE(result);
+            EXPECT_EQ(result.error(), "minimal:\n  " + test_root() +
+                                          "cps/minimal.cps does not implement all of the required components 'a, b'");
+        }
+
+        TEST(Errors, not_found) {
+            auto session = make_session();
+            auto && result = find_package(session, "does-not-exist", {}, true, std::nullopt);
+            ASSERT_FALSE(result);
+            EXPECT_EQ(result.error(), "Could not find a CPS file for does-not-exist");
+        }
+
+        TEST(Session, inputs) {
+            const std::string root = test_root();
+            auto session = make_session();
+            EXPECT_TRUE(session.inputs().empty());
+
+            // Nothing was found, but adding a file to a search directory would change that
+            ASSERT_FALSE(find_package(session, "does-not-exist", {}, true, std::nullopt));
+            auto && inputs = session.inputs();
+            ASSERT_GE(inputs.size(), 2u);
+            EXPECT_EQ(inputs[0], fs::path{root + "cps"});
+            EXPECT_EQ(inputs[1], fs::path{root + "pkgconfig"});
+
+            ASSERT_TRUE(find_package(session, "minimal", {}, true, std::nullopt));
+            inputs = session.inputs();
+            ASSERT_GE(inputs.size(), 3u);
+            EXPECT_EQ(inputs[0], fs::path{root + "cps/minimal.cps"});
+            EXPECT_EQ(inputs[1], fs::path{root + "cps"});
+        }
+
+        TEST(Session, inputs_of_missing_directory) {
+            const std::string root = test_root();
+            Session session{Env{.cps_path = std::vector<fs::path>{root + "missing/cps"}}};
+            ASSERT_FALSE(find_package(session, "does-not-exist", {}, true, std::nullopt));
+            auto && inputs = session.inputs();
+            ASSERT_FALSE(inputs.empty());
+            EXPECT_EQ(inputs[0], fs::path{root + "missing"}.parent_path());
+        }
+
+        TEST(Session, inputs_of_path) {
+            const std::string path = test_root() + "cps/minimal.cps";
+            auto session = make_session();
+            ASSERT_TRUE(find_package(session, path, {}, true, std::nullopt));
+            EXPECT_EQ(session.inputs(), std::vector<fs::path>{path});
+        }
+
+    } // namespace
+} // namespace cps::search::test
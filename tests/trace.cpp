@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+// Copyright © 2025 Dylan Baker
+
+#include "cps/trace.hpp"
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+namespace cps::trace::test {
+    namespace {
+
+        namespace fs = std::filesystem;
+
+        class Trace : public ::testing::Test {
+          protected:
+            void SetUp() override {
+                output = fs::temp_directory_path() /
+                         (::testing::UnitTest::GetInstance()->current_test_info()->name() + std::string{".json"});
+            }
+            void TearDown() override {
+                std::error_code ec;
+                fs::remove(output, ec);
+            }
+
+            nlohmann::json read() {
+                std::ifstream in{output};
+                return nlohmann::json::parse(in);
+            }
+
+            fs::path output;
+        };
+
+        TEST_F(Trace, disabled) {
+            ASSERT_FALSE(enabled());
+            Span span{"disabled"};
+            EXPECT_FALSE(span.active());
+            span.arg("key", "value");
+            ASSERT_TRUE(finish());
+            EXPECT_FALSE(fs::exists(output));
+        }
+
+        TEST_F(Trace, spans) {
+            start(output);
+            EXPECT_TRUE(enabled());
+            {
+                Span outer{"outer", "test"};
+                EXPECT_TRUE(outer.active());
+                outer.arg("name", "value");
+                Span inner{"inner"};
+                inner.arg("bytes", int64_t{42});
+            }
+            ASSERT_TRUE(finish());
+            EXPECT_FALSE(enabled());
+
+            const nlohmann::json trace = read();
+            auto && events = trace["traceEvents"];
+            ASSERT_EQ(events.size(), 2u);
+
+            // Spans are recorded as they end
+            auto && inner = events[0];
+            EXPECT_EQ(inner["name"], "inner");
+            EXPECT_EQ(inner["cat"], "cps");
+            EXPECT_EQ(inner["ph"], "X");
+            EXPECT_EQ(inner["args"]["bytes"], 42);
+
+            auto && outer = events[1];
+            EXPECT_EQ(outer["name"], "outer");
+            EXPECT_EQ(outer["cat"], "test");
+            EXPECT_EQ(outer["args"]["name"], "value");
+            EXPECT_LE(outer["ts"].get<double>(), inner["ts"].get<double>());
+            EXPECT_GE(outer["dur"].get<double>(), inner["dur"].get<double>());
+        }
+
+        TEST_F(Trace, open_spans_are_dropped) {
+            start(output);
+            Span open{"open"};
+            ASSERT_TRUE(finish());
+            EXPECT_EQ(read()["traceEvents"].size(), 0u);
+        }
+
+        TEST_F(Trace, unwritable) {
+            start(output / "not-a-directory" / "trace.json");
+            auto && r = finish();
+            ASSERT_FALSE(r);
+            EXPECT_NE(r.error().find("Could not open trace file"), std::string::npos);
+        }
+
+    } // namespace
+} // namespace cps::trace::test
@@ -38,5 +38,22 @@ namespace cps::utils::test {
             ASSERT_EQ(actual, expected);
         }
 
+        TEST(SplitWhitespaceTest, common) {
+            const std::vector<std::string> expected{"-L/usr/lib", "-lfoo", "-lbar"};
+            const std::vector<std::string> actual = utils::split_whitespace("-L/usr/lib -lfoo\t -lbar");
+            ASSERT_EQ(actual, expected);
+        }
+
+        TEST(SplitWhitespaceTest, surrounding) {
+            const std::vector<std::string> expected{"-lfoo"};
+            const std::vector<std::string> actual = utils::split_whitespace("  -lfoo  ");
+            ASSERT_EQ(actual, expected);
+        }
+
+        TEST(SplitWhitespaceTest, empty) {
+            const std::vector<std::string> actual = utils::split_whitespace("   ");
+            ASSERT_TRUE(actual.empty());
+        }
+
     } // unnamed namespace
 } // namespace cps::utils::test
@@ -61,5 +61,30 @@ namespace cps::version::test {
                 std::tuple("1+1", Operator::lt, "1-1", false), std::tuple("1+1", Operator::gt, "1-1", false),
                 std::tuple("001.0.0-1", Operator::eq, "1+001", true), std::tuple("0.0.0", Operator::ne, "10.0", true),
                 std::tuple("0.0.0", Operator::ne, "0", false)));
+
+        class RpmVersionTest : public ::testing::TestWithParam<std::tuple<std::string, Operator, std::string, bool>> {};
+
+        TEST_P(RpmVersionTest, compare) {
+            auto && [v1, op, v2, expected] = GetParam();
+            auto && result = version::compare(v1, op, v2, version::Schema::rpm);
+            ASSERT_TRUE(result.has_value()) << "Unexpected error " << result.error();
+            ASSERT_EQ(result.value(), expected) << "Case: " << v1 << " " << to_string(op) << " " << v2 << std::endl;
+        }
+
+        // Mostly from the rpmvercmp tests of rpm and pkgconf
+        INSTANTIATE_TEST_SUITE_P(
+            VersionTest, RpmVersionTest,
+            ::testing::Values(
+                std::tuple("1.0", Operator::eq, "1.0", true), std::tuple("1.0", Operator::lt, "2.0", true),
+                std::tuple("2.0.1", Operator::gt, "2.0", true), std::tuple("2.0", Operator::eq, "2_0", true),
+                std::tuple("1.0010", Operator::gt, "1.9", true), std::tuple("1.05", Operator::eq, "1.5", true),
+                std::tuple("1.0", Operator::ne, "1.0.0", true), std::tuple("1.0a", Operator::gt, "1.0", true),
+                std::tuple("5.5p1", Operator::lt, "5.5p2", true), std::tuple("5.5p10", Operator::gt, "5.5p1", true),
+                std::tuple("10xyz", Operator::lt, "10.1xyz", true), std::tuple("xyz10", Operator::lt, "xyz10.1", true),
+                std::tuple("2a", Operator::lt, "2.0", true), std::tuple("1.0", Operator::gt, "1.fc4", true),
+                std::tuple("3.0.0_fc", Operator::eq, "3.0.0.fc", true), std::tuple("1.0^", Operator::gt, "1.0", true),
+                std::tuple("1.0~rc1", Operator::lt, "1.0~rc2", true), std::tuple("1.0~rc1", Operator::lt, "1.0", true),
+                std::tuple("1.0^git1", Operator::lt, "1.0.1", true), std::tuple("0.1", Operator::ge, "1.0", false),
+                std::tuple("1.0", Operator::le, "1.0", true), std::tuple("1.0", Operator::gt, "1.0", false)));
     } // unnamed namespace
 } // namespace cps::version::test